@@ -0,0 +1,159 @@
+/*
+ * FILE: bench_check.cc
+ * DESCRIPTION: The integrity codes of utils.cc, cost against strength.
+ *       Each implementation is timed on a full packet, then each code
+ *       guards random data packets put through the corruption model of the
+ *       simulated link (every byte shifted by -10..9), counting the
+ *       corrupted packets the receiver would take as intact: those whose
+ *       payload size agrees with their length and whose check passes
+ *       although the bytes it covers changed.  Two CSV tables:
+ *
+ *           impl,ns_per_packet,bytes_per_cycle
+ *           code,packets,corrupted,undetected,undetected_rate
+ *
+ *       bytes_per_cycle, read from the time stamp counter, is left out on
+ *       cpus without one (anything but x86).
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC
+#endif
+
+#include "rdt_random.h"
+#include "utils.h"
+
+
+/* the sequence and size field widths of the default window and MTU */
+static const int SEQ_WIDTH = 1;
+static const int LEN_WIDTH = 1;
+
+/* corrupted packets per code */
+static const long NPACKETS = 20000000;
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+/* time a checksum or CRC over the covered bytes of a full packet, about
+   20ms worth of calls */
+template <typename Fn>
+static void time_impl(const char *name, Fn fn, const char *buf, int len)
+{
+    volatile u_int32_t sink = 0;
+    long iters = 1000;
+    for (;;) {
+        double t0 = now();
+#ifdef HAVE_TSC
+        unsigned long long c0 = __rdtsc();
+#endif
+        for (long i = 0; i<iters; i++)
+            sink = sink + fn(buf, len);
+#ifdef HAVE_TSC
+        unsigned long long cycles = __rdtsc()-c0;
+#endif
+        double elapsed = now()-t0;
+        if (elapsed>=0.02) {
+#ifdef HAVE_TSC
+            fprintf(stdout, "%s,%.2f,%.3f\n", name, elapsed/iters*1e9,
+                    (double)len*iters/cycles);
+#else
+            fprintf(stdout, "%s,%.2f\n", name, elapsed/iters*1e9);
+#endif
+            return;
+        }
+        iters *= 2;
+    }
+}
+
+/* fill a data packet of up to RDT_PKTSIZE bytes with a random payload and
+   its check */
+static void make_packet(struct packet *pkt, int kind, Random *rng)
+{
+    int width = CheckWidth(kind);
+    int header_size = HeaderSize(SEQ_WIDTH, width, LEN_WIDTH, 0);
+    int payload_size = 1 + (int)(rng->uniform()*(RDT_PKTSIZE-header_size));
+
+    pkt->size = header_size+payload_size;
+    memset(pkt->data, 0, header_size);
+    PutSize(pkt, width, LEN_WIDTH, payload_size);
+    PutSeq(pkt, width, LEN_WIDTH, SEQ_WIDTH, (seq_nr_t)(rng->next() & 0x7f), false);
+    for (int i = 0; i<payload_size; i++)
+        pkt->data[header_size+i] = (char)rng->next();
+    PutCheck(pkt, kind, pkt->size);
+}
+
+/* what Sender_ToLowerLayer() does to a corrupted packet */
+static void corrupt(struct packet *pkt, Random *rng)
+{
+    for (int i = 0; i<pkt->size; i++)
+        pkt->data[i] = pkt->data[i] + (char)(rng->uniform()*20) - 10;
+}
+
+static void detection(int kind)
+{
+    Random rng(1);
+    int width = CheckWidth(kind);
+    int header_size = HeaderSize(SEQ_WIDTH, width, LEN_WIDTH, 0);
+    long corrupted = 0, undetected = 0;
+    char buf[RDT_PKTSIZE], sent[RDT_PKTSIZE];
+
+    for (long n = 0; n<NPACKETS; n++) {
+        struct packet pkt;
+        pkt.data = buf;
+        make_packet(&pkt, kind, &rng);
+        memcpy(sent, buf, pkt.size);
+        corrupt(&pkt, &rng);
+
+        /* the bytes the receiver relies on, check field aside */
+        if (memcmp(pkt.data+width, sent+width, pkt.size-width)==0) continue;
+        corrupted++;
+
+        int size = GetSize(&pkt, width, LEN_WIDTH);
+        if (size+header_size!=pkt.size) continue;
+        if (CheckPassed(&pkt, kind, pkt.size)) undetected++;
+    }
+    fprintf(stdout, "%s,%ld,%ld,%ld,%.3g\n", CheckName(kind), NPACKETS,
+            corrupted, undetected, (double)undetected/corrupted);
+}
+
+int main(int argc, char *argv[])
+{
+    char buf[RDT_PKTSIZE];
+    for (int i = 0; i<RDT_PKTSIZE; i++) buf[i] = rand();
+
+    static const char *const sums[] = {"bytes", "word64", "sse2", "avx2"};
+    static const char *const crcs[] = {"slice8", "sse42"};
+    char name[64];
+
+#ifdef HAVE_TSC
+    fprintf(stdout, "impl,ns_per_packet,bytes_per_cycle\n");
+#else
+    fprintf(stdout, "impl,ns_per_packet\n");
+#endif
+    for (size_t i = 0; i<sizeof(sums)/sizeof(sums[0]); i++) {
+        chksum_fn fn = ChksumImpl(sums[i]);
+        if (fn==NULL) continue;
+        snprintf(name, sizeof(name), "sum16/%s", sums[i]);
+        time_impl(name, fn, buf, RDT_PKTSIZE-CheckWidth(CHECK_SUM16));
+    }
+    for (size_t i = 0; i<sizeof(crcs)/sizeof(crcs[0]); i++) {
+        crc32c_fn fn = Crc32cImpl(crcs[i]);
+        if (fn==NULL) continue;
+        snprintf(name, sizeof(name), "crc32c/%s", crcs[i]);
+        time_impl(name, fn, buf, RDT_PKTSIZE-CheckWidth(CHECK_CRC32C));
+    }
+
+    fprintf(stdout, "\ncode,packets,corrupted,undetected,undetected_rate\n");
+    detection(CHECK_SUM16);
+    detection(CHECK_CRC32C);
+    return 0;
+}
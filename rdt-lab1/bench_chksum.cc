@@ -0,0 +1,125 @@
+/*
+ * FILE: bench_chksum.cc
+ * DESCRIPTION: Micro-benchmark of the checksum implementations in utils.cc.
+ *       Every implementation is first checked against the byte-at-a-time
+ *       reference on random data of every length and alignment, then timed
+ *       on each length, one CSV row per implementation and length:
+ *
+ *           impl,len,ns_per_call,bytes_per_cycle
+ *
+ *       Lengths are the payloads of a 128-byte packet (1..128) followed by
+ *       larger packets.  Cycles are read from the time stamp counter, which
+ *       runs at the nominal clock rate; on cpus without one (anything but
+ *       x86) the bytes_per_cycle column is left out.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC
+#endif
+
+#include "utils.h"
+
+
+static const char *const impls[] = {"bytes", "word64", "sse2", "avx2"};
+static const int NIMPLS = sizeof(impls)/sizeof(impls[0]);
+
+static const int large_lens[] = {256, 512, 1500, 4096, 9000};
+static const int MAXLEN = 9000;
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+/* every implementation must agree with the reference */
+static bool verify(const u_int8_t *buf)
+{
+    chksum_fn ref = ChksumImpl("bytes");
+    for (int k = 0; k<NIMPLS; k++) {
+        chksum_fn fn = ChksumImpl(impls[k]);
+        if (fn==NULL) continue;
+        for (int off = 0; off<32; off++) {
+            for (int len = 0; len<=600; len++) {
+                if (fn(buf+off, len)!=ref(buf+off, len)) {
+                    fprintf(stderr, "%s differs at offset %d, length %d\n",
+                            impls[k], off, len);
+                    return false;
+                }
+            }
+            if (fn(buf+off, MAXLEN)!=ref(buf+off, MAXLEN)) {
+                fprintf(stderr, "%s differs at offset %d, length %d\n",
+                        impls[k], off, MAXLEN);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/* time one implementation on one length, about 20ms worth of calls */
+static void run(const char *name, chksum_fn fn, const u_int8_t *buf, int len)
+{
+    volatile u_int16_t sink = 0;
+    long iters = 1000;
+    for (;;) {
+        double t0 = now();
+#ifdef HAVE_TSC
+        unsigned long long c0 = __rdtsc();
+#endif
+        for (long i = 0; i<iters; i++) {
+            sink = sink + fn(buf, len);
+        }
+#ifdef HAVE_TSC
+        unsigned long long cycles = __rdtsc()-c0;
+#endif
+        double elapsed = now()-t0;
+        if (elapsed>=0.02) {
+#ifdef HAVE_TSC
+            fprintf(stdout, "%s,%d,%.2f,%.3f\n", name, len,
+                    elapsed/iters*1e9, (double)len*iters/cycles);
+#else
+            fprintf(stdout, "%s,%d,%.2f\n", name, len, elapsed/iters*1e9);
+#endif
+            return;
+        }
+        iters *= 2;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    u_int8_t *buf = (u_int8_t*)malloc(MAXLEN+32);
+    srand(1);
+    for (int i = 0; i<MAXLEN+32; i++) buf[i] = rand();
+
+    if (!verify(buf)) return 1;
+    fprintf(stderr, "all implementations agree, chksum() runs %s\n",
+            ChksumImplName());
+
+#ifdef HAVE_TSC
+    fprintf(stdout, "impl,len,ns_per_call,bytes_per_cycle\n");
+#else
+    fprintf(stdout, "impl,len,ns_per_call\n");
+#endif
+    for (int k = 0; k<NIMPLS; k++) {
+        chksum_fn fn = ChksumImpl(impls[k]);
+        if (fn==NULL) {
+            fprintf(stderr, "%s not supported by this cpu, skipped\n", impls[k]);
+            continue;
+        }
+        for (int len = 1; len<=RDT_PKTSIZE; len++)
+            run(impls[k], fn, buf, len);
+        for (size_t i = 0; i<sizeof(large_lens)/sizeof(large_lens[0]); i++)
+            run(impls[k], fn, buf, large_lens[i]);
+    }
+    free(buf);
+    return 0;
+}
@@ -0,0 +1,321 @@
+/*
+ * FILE: bench_rdt.cc
+ * DESCRIPTION: The hot paths of the simulator under Google Benchmark, so a
+ *       regression shows up as a number: the 16-bit checksum and sequence
+ *       number arithmetic of utils.cc, a message packetised by the sender,
+ *       packets reassembled by the receiver, the event chain under each
+ *       queue engine, and whole runs over a fixed grid of windows, MTUs and
+ *       loss rates, counting the simulation events and the bytes delivered
+ *       per wall-clock second.
+ *
+ *       The simulator is linked in without its main() (-DRDT_NO_MAIN);
+ *       the rdt layers are driven directly on a simulation of their own.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "rdt_struct.h"
+#include "rdt_sender.h"
+#include "rdt_receiver.h"
+#include "rdt_sim.h"
+#include "utils.h"
+
+
+/*[]------------------------------------------------------------------------[]
+  |  utils.cc
+  []------------------------------------------------------------------------[]*/
+
+static void BM_Chksum(benchmark::State &state)
+{
+    int len = state.range(0);
+    std::vector<char> data(len);
+    Random rng(1);
+    for (int i = 0; i<len; i++) data[i] = (char)rng.next();
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(chksum(&data[0], len));
+    state.SetBytesProcessed(state.iterations()*len);
+}
+BENCHMARK(BM_Chksum)->Arg(16)->Arg(RDT_PKTSIZE)->Arg(1500)->Arg(RDT_PKTSIZE_MAX);
+
+/* random triples of sequence numbers of a field seq_width bytes wide, each
+   in the window or out of it as it falls */
+static void BM_Between(benchmark::State &state)
+{
+    const int N = 1024;
+    uint64_t max = SeqSize(state.range(0));
+    seq_nr_t seqs[3*N];
+    Random rng(1);
+    for (int i = 0; i<3*N; i++) seqs[i] = (seq_nr_t)(rng.next() % max);
+
+    int i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(between(seqs[3*i], seqs[3*i+1], seqs[3*i+2], max));
+        i = (i+1) & (N-1);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Between)->Arg(1)->Arg(4);
+
+
+/*[]------------------------------------------------------------------------[]
+  |  the rdt layers
+  []------------------------------------------------------------------------[]*/
+
+/* a clean link and a window wide enough that nothing waits, each message
+   size bytes large */
+static void rdt_config(struct sim_config *cfg, int size)
+{
+    SimConfig_Default(cfg);
+    cfg->sim_time = 1;
+    cfg->msg_arrivalint = 0.1;
+    cfg->msg_size = size;
+    cfg->window_size = 4096;
+    cfg->seq_width = SeqWidthFor(cfg->window_size, 1);
+}
+
+/* set up the rdt layers of the single connection, as Simulation::run()
+   does */
+static void rdt_init(Simulation *sim)
+{
+    sim->select(0);
+    Sender_Init(sim);
+    Receiver_Init(sim);
+    sim->conn->sender = sim->sender;
+    sim->conn->receiver = sim->receiver;
+}
+
+/* take every pending event off the chain and back to its pool, the timers
+   with them */
+static void drain(Simulation *sim)
+{
+    for (Event *e; (e = sim->sim_core.next_event())!=NULL; ) {
+        switch (e->event_type) {
+        case EVENT_SENDER_FROMUPPERLAYER:
+            sim->upper_event_pool.release((EventSenderFromUpperLayer*)e);
+            break;
+        case EVENT_SENDER_FROMLOWERLAYER:
+            sim->sender_event_pool.release((EventSenderFromLowerLayer*)e);
+            break;
+        case EVENT_SENDER_TIMEOUT:
+            sim->timeout_event_pool.release((EventSenderTimeout*)e);
+            break;
+        case EVENT_RECEIVER_FROMLOWERLAYER:
+            sim->receiver_event_pool.release((EventReceiverFromLowerLayer*)e);
+            break;
+        case EVENT_RECEIVER_TIMEOUT:
+            sim->receiver_timeout_pool.release((EventReceiverTimeout*)e);
+            break;
+        }
+    }
+    sim->conn->sender_timer = NULL;
+    sim->conn->receiver_timer = NULL;
+}
+
+/* start the rdt layers over, from sequence number 0 */
+static void rdt_restart(Simulation *sim)
+{
+    drain(sim);
+    Sender_Final(sim);
+    Receiver_Final(sim);
+    rdt_init(sim);
+}
+
+static void rdt_close(Simulation *sim)
+{
+    drain(sim);
+    Sender_Final(sim);
+    Receiver_Final(sim);
+    delete sim;
+}
+
+/* a message of size bytes, as generate_msg() fills it */
+static struct message *make_msg(int size)
+{
+    struct message *msg = (struct message*) malloc(sizeof(struct message));
+    msg->size = size;
+    msg->data = (char*) malloc(size);
+    for (int i = 0; i<size; i++) msg->data[i] = '0' + i % 10;
+    return msg;
+}
+
+static void free_msg(struct message *msg)
+{
+    free(msg->data);
+    free(msg);
+}
+
+/* the packets a message of size bytes is split into */
+static int msg_packets(const struct sim_config *cfg, int size)
+{
+    int payload = cfg->mtu - HeaderSize(cfg->seq_width, cfg->check_width,
+                                        cfg->size_width, cfg->conn_width);
+    return (size + payload - 1) / payload;
+}
+
+/* a message packetised, its packets sent down to the link.  the sender
+   starts over once its window is full */
+static void BM_SenderFromUpperLayer(benchmark::State &state)
+{
+    int size = state.range(0);
+    struct sim_config cfg;
+    rdt_config(&cfg, size);
+    Simulation *sim = new Simulation(&cfg);
+    rdt_init(sim);
+    struct message *msg = make_msg(size);
+    int per_window = cfg.window_size / msg_packets(&cfg, size);
+
+    int sent = 0;
+    for (auto _ : state) {
+        if (sent==per_window) {
+            state.PauseTiming();
+            rdt_restart(sim);
+            state.ResumeTiming();
+            sent = 0;
+        }
+        Sender_FromUpperLayer(sim, msg);
+        sent++;
+    }
+    state.SetBytesProcessed(state.iterations()*size);
+
+    free_msg(msg);
+    rdt_close(sim);
+}
+BENCHMARK(BM_SenderFromUpperLayer)->Arg(100)->Arg(1000)->Arg(10000);
+
+/* a packet taken in order, acked, and its message passed up once whole.
+   the packets are those the sender sends for a window of messages, the
+   receiver starting over after the last of them */
+static void BM_ReceiverFromLowerLayer(benchmark::State &state)
+{
+    int size = state.range(0);
+    struct sim_config cfg;
+    rdt_config(&cfg, size);
+    Simulation *sim = new Simulation(&cfg);
+    rdt_init(sim);
+
+    struct message *msg = make_msg(size);
+    int per_window = cfg.window_size / msg_packets(&cfg, size);
+    for (int i = 0; i<per_window; i++) Sender_FromUpperLayer(sim, msg);
+    free_msg(msg);
+
+    /* the link delays every packet the same, so they come off the chain in
+       the order sent */
+    std::vector<std::string> stream;
+    for (Event *e; (e = sim->sim_core.next_event())!=NULL; ) {
+        if (e->event_type==EVENT_RECEIVER_FROMLOWERLAYER) {
+            EventReceiverFromLowerLayer *real_e = (EventReceiverFromLowerLayer*) e;
+            stream.push_back(std::string(real_e->pkt.data, real_e->pkt.size));
+            sim->receiver_event_pool.release(real_e);
+        }
+        else if (e->event_type==EVENT_SENDER_TIMEOUT) {
+            sim->timeout_event_pool.release((EventSenderTimeout*)e);
+        }
+    }
+    sim->conn->sender_timer = NULL;
+    rdt_restart(sim);
+
+    size_t next = 0;
+    char buf[RDT_PKTSIZE_MAX];
+    struct packet pkt;
+    pkt.data = buf;
+    for (auto _ : state) {
+        if (next==stream.size()) {
+            state.PauseTiming();
+            rdt_restart(sim);
+            state.ResumeTiming();
+            next = 0;
+        }
+        pkt.size = stream[next].size();
+        memcpy(buf, stream[next].data(), pkt.size);
+        Receiver_FromLowerLayer(sim, &pkt);
+        next++;
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    rdt_close(sim);
+}
+BENCHMARK(BM_ReceiverFromLowerLayer)->Arg(100)->Arg(1000)->Arg(10000);
+
+
+/*[]------------------------------------------------------------------------[]
+  |  the event chain
+  []------------------------------------------------------------------------[]*/
+
+/* the hold model: n events pending, the earliest taken off and scheduled
+   again up to 200ms on, about as far as the link and timers reach */
+static void BM_EventChainHold(benchmark::State &state, const char *kind)
+{
+    int n = state.range(0);
+    EventChain chain(EventQueue_Create(kind, 0.001));
+    std::vector<Event> events(n);
+    Random rng(1);
+    for (int i = 0; i<n; i++) {
+        events[i].sched_time = 0.2*rng.uniform();
+        chain.schedule(&events[i]);
+    }
+
+    for (auto _ : state) {
+        Event *e = chain.next_event();
+        e->sched_time = chain.time() + 0.2*rng.uniform();
+        chain.schedule(e);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_CAPTURE(BM_EventChainHold, list, "list")->Range(16, 1024);
+BENCHMARK_CAPTURE(BM_EventChainHold, heap, "heap")->Range(16, 1<<16);
+BENCHMARK_CAPTURE(BM_EventChainHold, heap4, "heap4")->Range(16, 1<<16);
+BENCHMARK_CAPTURE(BM_EventChainHold, wheel, "wheel")->Range(16, 1<<16);
+
+
+/*[]------------------------------------------------------------------------[]
+  |  whole runs
+  []------------------------------------------------------------------------[]*/
+
+/* 20 simulated seconds of a saturating sender (about 100KB/s offered),
+   over a window, MTU and loss rate (in percent) of the grid, with 15%
+   reordering.  events and bytes are those of the simulation, delivered to
+   the upper layer for bytes, per wall-clock second */
+static void BM_Simulation(benchmark::State &state)
+{
+    struct sim_config cfg;
+    SimConfig_Default(&cfg);
+    cfg.sim_time = 20;
+    cfg.msg_arrivalint = 0.001;
+    cfg.msg_size = 100;
+    cfg.outoforder_rate = 0.15;
+    cfg.loss_rate = state.range(2)/100.0;
+    cfg.corrupt_rate = 0;
+    cfg.window_size = state.range(0);
+    cfg.seq_width = SeqWidthFor(cfg.window_size, 1);
+    cfg.mtu = state.range(1);
+    cfg.size_width = SizeWidth(cfg.mtu);
+
+    double events = 0, bytes = 0;
+    for (auto _ : state) {
+        Simulation *sim = new Simulation(&cfg);
+        sim->run();
+        bool passed = sim->passed();
+        events += sim->sim_core.processed;
+        bytes += sim->tot_chars_delivered;
+        delete sim;
+        if (!passed) {
+            state.SkipWithError("the run is not error-free, loss-free and in order");
+            break;
+        }
+    }
+    state.counters["events"] = benchmark::Counter(events, benchmark::Counter::kIsRate);
+    state.counters["bytes"] = benchmark::Counter(bytes, benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_Simulation)
+    ->ArgNames({"window", "mtu", "loss"})
+    ->ArgsProduct({{10, 100, 1000}, {RDT_PKTSIZE, 1500}, {0, 15}})
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
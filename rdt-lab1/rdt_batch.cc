@@ -0,0 +1,396 @@
+/*
+ * FILE: rdt_batch.cc
+ * DESCRIPTION: Parameter sweep runner for non-interactive batch mode.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rdt_batch.h"
+#include "utils.h"
+
+
+/* the swept parameters, in the order the sweep nests them (seed varies
+   fastest) */
+enum {AXIS_TIME=0, AXIS_ARRIVAL, AXIS_SIZE, AXIS_OUTOFORDER, AXIS_LOSS,
+      AXIS_CORRUPT, AXIS_WINDOW, AXIS_MTU, AXIS_RATE, AXIS_CONNS, AXIS_SEED,
+      NAXES};
+
+static const char *axis_names[NAXES] = {
+    "time", "arrival", "size", "outoforder", "loss", "corrupt", "window", "mtu",
+    "rate", "conns", "seed"
+};
+
+/* the greatest value of each axis, an integer no larger for the integer
+   axes; 0 for the real ones, left to valid_scenario() */
+static const double axis_limits[NAXES] = {
+    0, 0, INT_MAX, 0, 0, 0, INT_MAX, INT_MAX, 0, INT_MAX, UINT_MAX
+};
+
+/* a scenario being run by a child process */
+struct batch_job {
+    struct batch_scenario sc;
+    int fd;                     /* read end of the result pipe */
+};
+
+static double wall_clock()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+/* parse the numbers of "start[:stop[:step]]", each taking all the text
+   up to its colon, return how many or 0 if one is malformed */
+static int parse_range(const std::string &item, double fields[3])
+{
+    int n = 0;
+    size_t pos = 0;
+    while (n<3) {
+        size_t colon = item.find(':', pos);
+        if (colon==std::string::npos) colon = item.size();
+        std::string field = item.substr(pos, colon-pos);
+        char *end;
+        fields[n] = strtod(field.c_str(), &end);
+        if (field.empty() || *end!='\0' || !isfinite(fields[n])) return 0;
+        n++;
+        if (colon==item.size()) return n;
+        pos = colon+1;
+    }
+    return 0;
+}
+
+/* parse "v1,v2,start:stop:step,..." into values.  with a limit, every
+   value must be an integer from 0 up to it */
+static bool parse_values(const char *text, double limit,
+                         std::vector<double> &values)
+{
+    values.clear();
+    std::string list(text);
+    size_t pos = 0;
+    while (pos<=list.size()) {
+        size_t comma = list.find(',', pos);
+        if (comma==std::string::npos) comma = list.size();
+        std::string item = list.substr(pos, comma-pos);
+        pos = comma+1;
+
+        double fields[3];
+        int n = parse_range(item, fields);
+        if (n==1) {
+            values.push_back(fields[0]);
+            continue;
+        }
+        double start = fields[0], stop = fields[1], step = n==3 ? fields[2] : 1;
+        if (n==0 || step<=0 || stop<start) return false;
+
+        /* inclusive range, tolerant to rounding of the step */
+        for (int i = 0; start + i*step <= stop + step*1e-9; i++)
+            values.push_back(start + i*step);
+    }
+    if (limit>0)
+        for (size_t i = 0; i<values.size(); i++)
+            if (values[i]<0 || values[i]>limit || values[i]!=floor(values[i]))
+                return false;
+    return !values.empty();
+}
+
+static bool parse_spec(const char *spec, const struct batch_scenario *defaults,
+                       std::vector<double> axes[NAXES])
+{
+    axes[AXIS_TIME].assign(1, defaults->sim_time);
+    axes[AXIS_ARRIVAL].assign(1, defaults->msg_arrivalint);
+    axes[AXIS_SIZE].assign(1, defaults->msg_size);
+    axes[AXIS_OUTOFORDER].assign(1, defaults->outoforder_rate);
+    axes[AXIS_LOSS].assign(1, defaults->loss_rate);
+    axes[AXIS_CORRUPT].assign(1, defaults->corrupt_rate);
+    axes[AXIS_WINDOW].assign(1, defaults->window_size);
+    axes[AXIS_MTU].assign(1, defaults->mtu);
+    axes[AXIS_RATE].assign(1, defaults->link_rate);
+    axes[AXIS_CONNS].assign(1, defaults->connections);
+    axes[AXIS_SEED].assign(1, defaults->seed);
+
+    std::string text(spec);
+    size_t pos = 0;
+    while (pos<text.size()) {
+        size_t semi = text.find(';', pos);
+        if (semi==std::string::npos) semi = text.size();
+        std::string item = text.substr(pos, semi-pos);
+        pos = semi+1;
+        if (item.empty()) continue;
+
+        size_t eq = item.find('=');
+        if (eq==std::string::npos) {
+            fprintf(stderr, "invalid sweep item %s\n", item.c_str());
+            return false;
+        }
+        std::string key = item.substr(0, eq);
+        int axis = 0;
+        while (axis<NAXES && key!=axis_names[axis]) axis++;
+        if (axis==NAXES || !parse_values(item.c_str()+eq+1, axis_limits[axis],
+                                       axes[axis])) {
+            fprintf(stderr, "invalid sweep item %s\n", item.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool valid_scenario(const struct batch_scenario *sc)
+{
+    return sc->sim_time>0 && sc->msg_arrivalint>0 && sc->msg_size>0
+        && sc->outoforder_rate>=0 && sc->outoforder_rate<=1
+        && sc->loss_rate>=0 && sc->loss_rate<=1
+        && sc->corrupt_rate>=0 && sc->corrupt_rate<=1
+        && sc->window_size>0 && sc->window_size<=WINDOW_MAX
+        && sc->mtu>=MTU_MIN && sc->mtu<=RDT_PKTSIZE_MAX
+        && sc->link_rate>=0
+        && sc->connections>0 && sc->connections<=CONN_MAX;
+}
+
+static void emit_header(const char *format)
+{
+    if (strcmp(format, "csv")==0)
+        fprintf(stdout, "run,sim_time,arrival,size,outoforder,loss,corrupt,window,mtu,rate,conns,seed,"
+                "status,end_time,chars_sent,chars_delivered,pkts_passed,"
+                "retransmissions,fast_retransmissions,queue_drops,goodput,"
+                "fairness,latency_p50,latency_p99,latency_p999,mean_rto,mean_cwnd,"
+                "wall_time,events,events_per_s\n");
+}
+
+static void emit_row(const char *format, const struct batch_scenario *sc,
+                     const struct batch_result *res, const char *status)
+{
+    double goodput = res->end_time>0 ? res->chars_delivered/res->end_time : 0;
+    double event_rate = res->wall_time>0 ? res->events/res->wall_time : 0;
+
+    if (strcmp(format, "csv")==0)
+        fprintf(stdout, "%d,%g,%g,%d,%g,%g,%g,%d,%d,%g,%d,%u,%s,%.3f,%d,%d,%d,%d,%d,%d,%.3f,%.4f,%.4f,%.4f,%.4f,%.4f,%.2f,%.6f,%llu,%.0f\n",
+                sc->run, sc->sim_time, sc->msg_arrivalint, sc->msg_size,
+                sc->outoforder_rate, sc->loss_rate, sc->corrupt_rate,
+                sc->window_size, sc->mtu, sc->link_rate, sc->connections,
+                sc->seed,
+                status, res->end_time, res->chars_sent, res->chars_delivered,
+                res->pkts_passed, res->pkts_retransmitted, 
+                res->pkts_fast_retransmitted, res->queue_drops, goodput,
+                res->fairness, res->latency_p50, res->latency_p99, res->latency_p999,
+                res->mean_rto, res->mean_cwnd, res->wall_time, res->events,
+                event_rate);
+    else
+        fprintf(stdout, "{\"run\": %d, \"sim_time\": %g, \"arrival\": %g, "
+                "\"size\": %d, \"outoforder\": %g, \"loss\": %g, \"corrupt\": %g, "
+                "\"window\": %d, \"mtu\": %d, \"rate\": %g, \"conns\": %d, \"seed\": %u, \"status\": \"%s\", \"end_time\": %.3f, "
+                "\"chars_sent\": %d, \"chars_delivered\": %d, \"pkts_passed\": %d, "
+                "\"retransmissions\": %d, \"fast_retransmissions\": %d, \"queue_drops\": %d, "
+                "\"goodput\": %.3f, \"fairness\": %.4f, \"latency_p50\": %.4f, \"latency_p99\": %.4f, "
+                "\"latency_p999\": %.4f, \"mean_rto\": %.4f, \"mean_cwnd\": %.2f, "
+                "\"wall_time\": %.6f, \"events\": %llu, \"events_per_s\": %.0f}\n",
+                sc->run, sc->sim_time, sc->msg_arrivalint, sc->msg_size,
+                sc->outoforder_rate, sc->loss_rate, sc->corrupt_rate,
+                sc->window_size, sc->mtu, sc->link_rate, sc->connections,
+                sc->seed,
+                status, res->end_time, res->chars_sent, res->chars_delivered,
+                res->pkts_passed, res->pkts_retransmitted, 
+                res->pkts_fast_retransmitted, res->queue_drops, goodput,
+                res->fairness, res->latency_p50, res->latency_p99, res->latency_p999,
+                res->mean_rto, res->mean_cwnd, res->wall_time, res->events,
+                event_rate);
+    fflush(stdout);
+}
+
+/* fork a child running one scenario, its result comes back on a pipe */
+static pid_t spawn(const struct batch_scenario *sc, batch_runner runner, int *fd)
+{
+    int fds[2];
+    if (pipe(fds)!=0) {
+        perror("pipe");
+        exit(-1);
+    }
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid<0) {
+        perror("fork");
+        exit(-1);
+    }
+
+    if (pid==0) {
+        /* the rdt layers trace to stdout, keep the rows clean */
+        close(fds[0]);
+        int devnull = open("/dev/null", O_WRONLY);
+        if (devnull>=0) dup2(devnull, STDOUT_FILENO);
+
+        struct batch_result res;
+        memset(&res, 0, sizeof(res));
+        double start = wall_clock();
+        runner(sc, &res);
+        res.wall_time = wall_clock() - start;
+
+        if (write(fds[1], &res, sizeof(res))!=(ssize_t)sizeof(res))
+            _exit(1);
+        _exit(0);
+    }
+
+    close(fds[1]);
+    *fd = fds[0];
+    return pid;
+}
+
+/* worker thread loop: take the next scenario until there are none left */
+static void run_worker(const std::vector<struct batch_scenario> *scenarios,
+                       std::atomic<size_t> *next, std::mutex *out_lock,
+                       const char *format, batch_runner runner, int *failed)
+{
+    for (;;) {
+        size_t i = (*next)++;
+        if (i>=scenarios->size()) break;
+
+        struct batch_result res;
+        memset(&res, 0, sizeof(res));
+        double start = wall_clock();
+        runner(&(*scenarios)[i], &res);
+        res.wall_time = wall_clock() - start;
+
+        std::lock_guard<std::mutex> guard(*out_lock);
+        if (!res.passed) (*failed)++;
+        emit_row(format, &(*scenarios)[i], &res, res.passed ? "passed" : "failed");
+    }
+}
+
+/* run the scenarios on child processes, up to jobs at a time */
+static int run_processes(const std::vector<struct batch_scenario> &scenarios,
+                         int jobs, const char *format, batch_runner runner)
+{
+    std::map<pid_t, struct batch_job> running;
+    size_t next = 0;
+    int failed = 0;
+    while (next<scenarios.size() || !running.empty()) {
+        /* keep up to jobs children busy */
+        while (next<scenarios.size() && (int)running.size()<jobs) {
+            struct batch_job job;
+            job.sc = scenarios[next++];
+            pid_t pid = spawn(&job.sc, runner, &job.fd);
+            running[pid] = job;
+        }
+
+        int wstatus;
+        pid_t pid = waitpid(-1, &wstatus, 0);
+        if (pid<0) {
+            perror("waitpid");
+            return -1;
+        }
+        std::map<pid_t, struct batch_job>::iterator it = running.find(pid);
+        if (it==running.end()) continue;
+
+        struct batch_result res;
+        memset(&res, 0, sizeof(res));
+        bool completed = read(it->second.fd, &res, sizeof(res))==(ssize_t)sizeof(res)
+            && WIFEXITED(wstatus) && WEXITSTATUS(wstatus)==0;
+        close(it->second.fd);
+
+        const char *status = !completed ? "crashed" : res.passed ? "passed" : "failed";
+        if (!completed || !res.passed) failed++;
+        emit_row(format, &it->second.sc, &res, status);
+        running.erase(it);
+    }
+    return failed;
+}
+
+void Batch_Defaults(struct batch_scenario *sc)
+{
+    sc->run = 0;
+    sc->sim_time = 1000;
+    sc->msg_arrivalint = 0.1;
+    sc->msg_size = 100;
+    sc->outoforder_rate = 0.15;
+    sc->loss_rate = 0.15;
+    sc->corrupt_rate = 0.15;
+    sc->window_size = 10;
+    sc->mtu = RDT_PKTSIZE;
+    sc->link_rate = 0;
+    sc->connections = 1;
+    sc->seed = 1;
+}
+
+int Batch_Run(const char *spec, const struct batch_scenario *defaults,
+              int jobs, bool processes, const char *format,
+              batch_runner runner)
+{
+    if (strcmp(format, "csv")!=0 && strcmp(format, "json")!=0) {
+        fprintf(stderr, "invalid batch format %s\n", format);
+        return -1;
+    }
+
+    std::vector<double> axes[NAXES];
+    if (!parse_spec(spec, defaults, axes)) return -1;
+
+    int total = 1;
+    for (int i = 0; i<NAXES; i++)
+        total *= axes[i].size();
+
+    emit_header(format);
+
+    /* expand the sweep, invalid points are reported right away */
+    std::vector<struct batch_scenario> scenarios;
+    int failed = 0;
+    for (int run = 0; run<total; run++) {
+        struct batch_scenario sc;
+        int index[NAXES];
+        for (int i = NAXES-1, rest = run; i>=0; i--) {
+            index[i] = rest % axes[i].size();
+            rest /= axes[i].size();
+        }
+
+        sc.run = run;
+        sc.sim_time = axes[AXIS_TIME][index[AXIS_TIME]];
+        sc.msg_arrivalint = axes[AXIS_ARRIVAL][index[AXIS_ARRIVAL]];
+        sc.msg_size = (int)axes[AXIS_SIZE][index[AXIS_SIZE]];
+        sc.outoforder_rate = axes[AXIS_OUTOFORDER][index[AXIS_OUTOFORDER]];
+        sc.loss_rate = axes[AXIS_LOSS][index[AXIS_LOSS]];
+        sc.corrupt_rate = axes[AXIS_CORRUPT][index[AXIS_CORRUPT]];
+        sc.window_size = (int)axes[AXIS_WINDOW][index[AXIS_WINDOW]];
+        sc.mtu = (int)axes[AXIS_MTU][index[AXIS_MTU]];
+        sc.link_rate = axes[AXIS_RATE][index[AXIS_RATE]];
+        sc.connections = (int)axes[AXIS_CONNS][index[AXIS_CONNS]];
+        sc.seed = (unsigned int)axes[AXIS_SEED][index[AXIS_SEED]];
+
+        if (!valid_scenario(&sc)) {
+            struct batch_result res;
+            memset(&res, 0, sizeof(res));
+            emit_row(format, &sc, &res, "invalid");
+            failed++;
+            continue;
+        }
+        scenarios.push_back(sc);
+    }
+
+    if (processes) {
+        int n = run_processes(scenarios, jobs, format, runner);
+        return n<0 ? -1 : failed+n;
+    }
+
+    std::atomic<size_t> next(0);
+    std::mutex out_lock;
+    std::vector<std::thread> workers;
+    for (int i = 0; i<jobs && i<(int)scenarios.size(); i++)
+        workers.push_back(std::thread(run_worker, &scenarios, &next, &out_lock,
+                                      format, runner, &failed));
+    for (size_t i = 0; i<workers.size(); i++)
+        workers[i].join();
+
+    return failed;
+}
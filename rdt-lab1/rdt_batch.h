@@ -0,0 +1,84 @@
+/*
+ * FILE: rdt_batch.h
+ * DESCRIPTION: Non-interactive batch mode.  A sweep spec lists the values of
+ *       each simulation parameter; the runner expands their cartesian
+ *       product and runs every scenario as an independent simulation, several
+ *       at a time on a pool of worker threads (or, for crash isolation, in
+ *       child processes), emitting one CSV or JSON row per run as it
+ *       completes.
+ *
+ *       The spec is a ';'-separated list of key=values, where values is a
+ *       ','-separated list of numbers or inclusive start:stop[:step] ranges:
+ *
+ *           loss=0:0.3:0.1;corrupt=0.1,0.2;size=100;seed=1:8
+ *
+ *       keys: time, arrival, size, outoforder, loss, corrupt, window, mtu,
+ *       rate, conns, seed.  Keys left out take the values passed in as
+ *       defaults: those of the README benchmark (1000 0.1 100 0.15 0.15
+ *       0.15, window 10, mtu 128, no bottleneck, one connection, seed 1),
+ *       except where the command line sets them with --window, --mtu,
+ *       --rate, --connections or --seed.  The other options apply to every
+ *       run.
+ */
+
+
+#ifndef _RDT_BATCH_H_
+#define _RDT_BATCH_H_
+
+/* one point of the parameter space */
+struct batch_scenario {
+    int run;                    /* index of the scenario in the sweep */
+    double sim_time;
+    double msg_arrivalint;
+    int msg_size;
+    double outoforder_rate;
+    double loss_rate;
+    double corrupt_rate;
+    int window_size;
+    int mtu;
+    double link_rate;           /* bottleneck in bytes/s, 0 for none */
+    int connections;            /* sharing the link */
+    unsigned int seed;
+};
+
+/* the outcome of one scenario */
+struct batch_result {
+    bool passed;                /* error-free, loss-free and in order */
+    double end_time;            /* simulation time at completion */
+    int chars_sent;
+    int chars_delivered;
+    int pkts_passed;
+    int pkts_retransmitted;
+    int pkts_fast_retransmitted;/* of them, ahead of their timer */
+    int queue_drops;            /* packets the bottleneck queues dropped */
+    double mean_rto;            /* mean retransmission timeout taken, over
+                                   the updates of all the senders */
+    double mean_cwnd;           /* congestion window averaged over time, then
+                                   over the connections */
+    double latency_p50;         /* message latency percentiles (in seconds) */
+    double latency_p99;
+    double latency_p999;
+    double fairness;            /* Jain's index of the connection goodputs */
+    unsigned long long events;  /* simulation events processed */
+    double wall_time;           /* wall-clock seconds spent */
+};
+
+/* run one scenario to completion, called on a worker thread or in a fresh
+   child process */
+typedef void (*batch_runner)(const struct batch_scenario *sc,
+                             struct batch_result *res);
+
+/* fill in the values of the README benchmark, every key of the spec */
+void Batch_Defaults(struct batch_scenario *sc);
+
+/* run every scenario of the sweep spec, the keys it leaves out taken from
+   defaults, up to jobs at a time on threads or, if processes is set, in
+   child processes, writing one row per run in format "csv" or "json" to
+   stdout.
+   return the number of runs that did not pass, or -1 if the spec is
+   invalid */
+int Batch_Run(const char *spec, const struct batch_scenario *defaults,
+              int jobs, bool processes, const char *format,
+              batch_runner runner);
+
+#endif  /* _RDT_BATCH_H_ */
@@ -0,0 +1,172 @@
+/*
+ * FILE: rdt_cc.cc
+ * DESCRIPTION: Congestion control algorithms of the sender.
+ */
+
+
+#include <math.h>
+#include <string.h>
+
+#include "rdt_cc.h"
+
+
+/*[]------------------------------------------------------------------------[]
+  |  no congestion control
+  []------------------------------------------------------------------------[]*/
+
+class NoCongestionControl : public CongestionControl
+{
+public:
+    NoCongestionControl(int max_window) { window = max_window; }
+
+    double cwnd() const { return window; }
+    double ssthresh() const { return window; }
+    void on_ack(int nacked, double now, double srtt) {}
+    void on_loss(double now) {}
+    void on_timeout(double now) {}
+    const char *name() const { return "none"; }
+
+private:
+    double window;
+};
+
+
+/*[]------------------------------------------------------------------------[]
+  |  Reno
+  []------------------------------------------------------------------------[]*/
+
+class RenoCongestionControl : public CongestionControl
+{
+public:
+    RenoCongestionControl(int max_window) {
+        this->max_window = max_window;
+        window = 1;
+        threshold = max_window;
+    }
+
+    double cwnd() const { return window; }
+    double ssthresh() const { return threshold; }
+
+    void on_ack(int nacked, double now, double srtt) {
+        /* one packet per ack in slow start, one per window afterwards */
+        for (int i = 0; i<nacked; i++)
+            window += window<threshold ? 1 : 1/window;
+        if (window>max_window) window = max_window;
+    }
+
+    void on_loss(double now) {
+        threshold = window/2>2 ? window/2 : 2;
+        window = threshold;
+    }
+
+    void on_timeout(double now) {
+        threshold = window/2>2 ? window/2 : 2;
+        window = 1;
+    }
+
+    const char *name() const { return "reno"; }
+
+private:
+    double max_window;
+    double window;
+    double threshold;
+};
+
+
+/*[]------------------------------------------------------------------------[]
+  |  CUBIC
+  []------------------------------------------------------------------------[]*/
+
+class CubicCongestionControl : public CongestionControl
+{
+public:
+    /* scaling constant (packets/s^3) and multiplicative decrease factor */
+    static constexpr double C = 0.4;
+    static constexpr double BETA = 0.7;
+
+public:
+    CubicCongestionControl(int max_window) {
+        this->max_window = max_window;
+        window = 1;
+        threshold = max_window;
+        w_max = 0;
+        k = 0;
+        epoch_start = -1;
+        w_est = 0;
+    }
+
+    double cwnd() const { return window; }
+    double ssthresh() const { return threshold; }
+
+    void on_ack(int nacked, double now, double srtt) {
+        if (window<threshold) {
+            window += nacked;
+        } else {
+            if (epoch_start<0) start_epoch(now);
+
+            /* aim for where the cubic will be a round trip from now, growing
+               by at most half a packet per ack */
+            double t = now + srtt - epoch_start;
+            double target = C*(t-k)*(t-k)*(t-k) + w_max;
+            for (int i = 0; i<nacked; i++) {
+                if (target>window)
+                    window += (target-window)/window<0.5 ? (target-window)/window : 0.5;
+                else
+                    window += 0.01/window;
+
+                /* never slower than Reno would be (the TCP-friendly
+                   region) */
+                w_est += 3*(1-BETA)/(1+BETA)/window;
+                if (w_est>window) window = w_est;
+            }
+        }
+        if (window>max_window) window = max_window;
+    }
+
+    void on_loss(double now) {
+        reduce();
+        window = threshold;
+    }
+
+    void on_timeout(double now) {
+        reduce();
+        window = 1;
+    }
+
+    const char *name() const { return "cubic"; }
+
+private:
+    double max_window;
+    double window;
+    double threshold;
+    double w_max;               /* window at the last loss */
+    double k;                   /* time the cubic takes to climb back to it */
+    double epoch_start;         /* start of the current growth epoch, or -1 */
+    double w_est;               /* the window Reno would have grown to */
+
+    void reduce() {
+        w_max = window;
+        threshold = window*BETA>2 ? window*BETA : 2;
+        epoch_start = -1;
+    }
+
+    void start_epoch(double now) {
+        epoch_start = now;
+        if (window<w_max) {
+            k = cbrt((w_max-window)/C);
+        } else {
+            k = 0;
+            w_max = window;
+        }
+        w_est = window;
+    }
+};
+
+
+CongestionControl *CongestionControl_Create(const char *kind, int max_window)
+{
+    if (strcmp(kind, "none")==0) return new NoCongestionControl(max_window);
+    if (strcmp(kind, "reno")==0) return new RenoCongestionControl(max_window);
+    if (strcmp(kind, "cubic")==0) return new CubicCongestionControl(max_window);
+    return NULL;
+}
@@ -0,0 +1,52 @@
+/*
+ * FILE: rdt_cc.h
+ * DESCRIPTION: Congestion control of the sender.  An algorithm keeps a
+ *       congestion window (in packets) from the acks and losses the sender
+ *       reports to it; the sender keeps no more than that many packets in
+ *       flight, on top of the limit of its sliding window:
+ *
+ *       none   - no congestion window, the sliding window alone limits
+ *       reno   - slow start, then additive increase by one packet per round
+ *                trip and multiplicative decrease by half on loss (AIMD)
+ *       cubic  - the window grows along a cubic function of the time since
+ *                the last loss, flattening out around the window the loss
+ *                happened at, and shrinks to 0.7 of it on loss
+ *
+ *       A timeout restarts slow start from one packet under every
+ *       algorithm but none.
+ */
+
+
+#ifndef _RDT_CC_H_
+#define _RDT_CC_H_
+
+
+/* the interface every congestion control algorithm implements */
+class CongestionControl
+{
+public:
+    virtual ~CongestionControl() {}
+
+    /* the congestion window and slow start threshold, in packets */
+    virtual double cwnd() const = 0;
+    virtual double ssthresh() const = 0;
+
+    /* nacked packets newly acknowledged at time now, srtt is the smoothed
+       round trip time of the sender */
+    virtual void on_ack(int nacked, double now, double srtt) = 0;
+
+    /* a packet taken as lost on duplicate or selective acks */
+    virtual void on_loss(double now) = 0;
+
+    /* a retransmission timeout */
+    virtual void on_timeout(double now) = 0;
+
+    virtual const char *name() const = 0;
+};
+
+/* create a congestion control algorithm by name ("none", "reno" or
+   "cubic"), the congestion window never grows past max_window.
+   return NULL if the name is unknown */
+CongestionControl *CongestionControl_Create(const char *kind, int max_window);
+
+#endif  /* _RDT_CC_H_ */
@@ -0,0 +1,319 @@
+/*
+ * FILE: rdt_event.cc
+ * DESCRIPTION: Event queue engines of the simulation core.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rdt_event.h"
+
+
+/* the total order events are delivered in: by time, then FIFO */
+static inline bool before(const Event *a, const Event *b)
+{
+    return a->sched_time<b->sched_time
+        || (a->sched_time==b->sched_time && a->seq<b->seq);
+}
+
+static inline void unlink(Event *e)
+{
+    e->prev->next = e->next;
+    e->next->prev = e->prev;
+}
+
+/* insert e in front of pos in a circular list */
+static inline void link_before(Event *pos, Event *e)
+{
+    e->next = pos;
+    e->prev = pos->prev;
+    pos->prev->next = e;
+    pos->prev = e;
+}
+
+EventQueue *EventQueue_Create(const char *kind, double tick)
+{
+    if (strcmp(kind, "list")==0) return new ListEventQueue;
+    if (strcmp(kind, "heap")==0) return new HeapEventQueue<2>;
+    if (strcmp(kind, "heap4")==0) return new HeapEventQueue<4>;
+    if (strcmp(kind, "wheel")==0 && tick>0) return new WheelEventQueue(tick);
+    return NULL;
+}
+
+
+/*[]------------------------------------------------------------------------[]
+  |  sorted linked list
+  []------------------------------------------------------------------------[]*/
+
+/* the chain is maintained on an increasing order of sched_time */
+void ListEventQueue::push(Event *e)
+{
+    Event **ppcur = &head;
+    while ((*ppcur!=NULL) && ((*ppcur)->sched_time<=e->sched_time))
+        ppcur = &((*ppcur)->next);
+
+    e->next = *ppcur;
+    e->qpos = 0;
+    *ppcur = e;
+    count++;
+}
+
+void ListEventQueue::remove(Event *e)
+{
+    Event **ppcur = &head;
+    while ((*ppcur!=NULL) && (*ppcur!=e))
+        ppcur = &((*ppcur)->next);
+
+    if (*ppcur==e) {
+        *ppcur = (*ppcur)->next;
+        e->qpos = -1;
+        count--;
+    }
+}
+
+Event *ListEventQueue::pop()
+{
+    if (head==NULL) return NULL;
+
+    Event *e = head;
+    head = head->next;
+    e->qpos = -1;
+    count--;
+    return e;
+}
+
+
+/*[]------------------------------------------------------------------------[]
+  |  d-ary heap
+  []------------------------------------------------------------------------[]*/
+
+template <int D>
+void HeapEventQueue<D>::sift_up(size_t i)
+{
+    Event *e = heap[i];
+    while (i>0) {
+        size_t parent = (i-1)/D;
+        if (!before(e, heap[parent])) break;
+        place(heap[parent], i);
+        i = parent;
+    }
+    place(e, i);
+}
+
+template <int D>
+void HeapEventQueue<D>::sift_down(size_t i)
+{
+    Event *e = heap[i];
+    size_t n = heap.size();
+    for (;;) {
+        size_t first = i*D+1;
+        if (first>=n) break;
+
+        size_t last = first+D < n ? first+D : n;
+        size_t best = first;
+        for (size_t c = first+1; c<last; c++)
+            if (before(heap[c], heap[best])) best = c;
+
+        if (!before(heap[best], e)) break;
+        place(heap[best], i);
+        i = best;
+    }
+    place(e, i);
+}
+
+template <int D>
+void HeapEventQueue<D>::push(Event *e)
+{
+    heap.push_back(e);
+    sift_up(heap.size()-1);
+}
+
+template <int D>
+void HeapEventQueue<D>::remove(Event *e)
+{
+    size_t i = (size_t)e->qpos;
+    Event *last = heap.back();
+    heap.pop_back();
+    e->qpos = -1;
+    if (last==e) return;
+
+    place(last, i);
+    if (i>0 && before(last, heap[(i-1)/D]))
+        sift_up(i);
+    else
+        sift_down(i);
+}
+
+template <int D>
+Event *HeapEventQueue<D>::pop()
+{
+    if (heap.empty()) return NULL;
+
+    Event *e = heap[0];
+    Event *last = heap.back();
+    heap.pop_back();
+    if (!heap.empty()) {
+        heap[0] = last;
+        sift_down(0);
+    }
+    e->qpos = -1;
+    return e;
+}
+
+template class HeapEventQueue<2>;
+template class HeapEventQueue<4>;
+
+
+/*[]------------------------------------------------------------------------[]
+  |  hierarchical timer wheel
+  []------------------------------------------------------------------------[]*/
+
+WheelEventQueue::WheelEventQueue(double tick)
+{
+    this->tick = tick;
+    cur = 0;
+    count = 0;
+    for (int level = 0; level<WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot<WHEEL_SLOTS; slot++)
+            slots[level][slot].next = slots[level][slot].prev = &slots[level][slot];
+    }
+    memset(bitmap, 0, sizeof(bitmap));
+    due.next = due.prev = &due;
+    overflow.next = overflow.prev = &overflow;
+}
+
+unsigned long long WheelEventQueue::tick_of(Event *e)
+{
+    return (unsigned long long)(e->sched_time/tick);
+}
+
+/* keep the due list sorted, new events usually belong at the tail */
+void WheelEventQueue::insert_due(Event *e)
+{
+    Event *pos = due.prev;
+    while (pos!=&due && before(e, pos))
+        pos = pos->prev;
+
+    link_before(pos->next, e);
+    e->qpos = POS_DUE;
+}
+
+void WheelEventQueue::place(Event *e)
+{
+    unsigned long long t = tick_of(e);
+    if (t<=cur) {
+        insert_due(e);
+        return;
+    }
+
+    /* the level is given by the highest digit in which t and cur differ */
+    unsigned long long diff = t^cur;
+    for (int level = 0; level<WHEEL_LEVELS; level++) {
+        int shift = level*WHEEL_BITS;
+        if ((diff>>shift) < (unsigned long long)WHEEL_SLOTS) {
+            int slot = (int)((t>>shift) & (WHEEL_SLOTS-1));
+            link_before(&slots[level][slot], e);
+            bitmap[level][slot/64] |= 1ULL<<(slot%64);
+            e->qpos = level*WHEEL_SLOTS + slot;
+            return;
+        }
+    }
+
+    link_before(&overflow, e);
+    e->qpos = POS_OVERFLOW;
+}
+
+/* the first non-empty slot of a level at or after from, -1 if none */
+int WheelEventQueue::find_slot(int level, int from)
+{
+    for (int word = from/64; word<WHEEL_WORDS; word++) {
+        unsigned long long bits = bitmap[level][word];
+        if (word==from/64) bits &= ~0ULL<<(from%64);
+        if (bits!=0) return word*64 + __builtin_ctzll(bits);
+    }
+    return -1;
+}
+
+/* turn the wheel until the due list holds the events of the next busy tick */
+void WheelEventQueue::advance()
+{
+    while (due.next==&due && count>0) {
+        int slot = find_slot(0, (int)(cur & (WHEEL_SLOTS-1)));
+        Event *list = NULL;
+        int level = 0;
+
+        if (slot>=0) {
+            cur = (cur & ~(unsigned long long)(WHEEL_SLOTS-1)) | slot;
+        }
+        else {
+            /* nothing left on this turn of level 0, jump to the next busy
+               slot of a higher level and cascade it down */
+            for (level = 1; level<WHEEL_LEVELS; level++) {
+                int shift = level*WHEEL_BITS;
+                slot = find_slot(level, (int)((cur>>shift) & (WHEEL_SLOTS-1)) + 1);
+                if (slot>=0) {
+                    unsigned long long span = (1ULL<<(shift+WHEEL_BITS)) - 1;
+                    cur = (cur & ~span) | ((unsigned long long)slot<<shift);
+                    break;
+                }
+            }
+        }
+
+        if (slot>=0) {
+            list = &slots[level][slot];
+            bitmap[level][slot/64] &= ~(1ULL<<(slot%64));
+        }
+        else {
+            /* only far-future events are left, jump to the earliest one */
+            list = &overflow;
+            unsigned long long t_min = ~0ULL;
+            for (Event *e = overflow.next; e!=&overflow; e = e->next) {
+                unsigned long long t = tick_of(e);
+                if (t<t_min) t_min = t;
+            }
+            cur = t_min;
+        }
+
+        /* detach the list and re-place its events relative to cur */
+        Event *e = list->next;
+        list->next = list->prev = list;
+        while (e!=list) {
+            Event *next = e->next;
+            place(e);
+            e = next;
+        }
+    }
+}
+
+void WheelEventQueue::push(Event *e)
+{
+    place(e);
+    count++;
+}
+
+void WheelEventQueue::remove(Event *e)
+{
+    Event *next = e->next;
+    unlink(e);
+    if (e->qpos<POS_DUE && next==e->prev) {
+        /* the slot became empty */
+        int level = e->qpos/WHEEL_SLOTS, slot = e->qpos%WHEEL_SLOTS;
+        bitmap[level][slot/64] &= ~(1ULL<<(slot%64));
+    }
+    e->qpos = -1;
+    count--;
+}
+
+Event *WheelEventQueue::pop()
+{
+    advance();
+    if (due.next==&due) return NULL;
+
+    Event *e = due.next;
+    unlink(e);
+    e->qpos = -1;
+    count--;
+    return e;
+}
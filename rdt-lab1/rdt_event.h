@@ -0,0 +1,190 @@
+/*
+ * FILE: rdt_event.h
+ * DESCRIPTION: The generic event chain framework of the simulation core.
+ *       The chain keeps the original semantics (events are delivered in
+ *       increasing order of sched_time, and events scheduled for the same
+ *       time are delivered in the order they were scheduled) on top of a
+ *       pluggable event queue:
+ *
+ *       list   - the original sorted singly linked list, O(n) schedule/cancel
+ *       heap   - binary min-heap, O(log n) schedule/next, O(log n) cancel
+ *       heap4  - 4-ary min-heap, shallower and more cache friendly
+ *       wheel  - hierarchical timer wheel, O(1) schedule/cancel, suited to
+ *                the fixed pkt_latency of the link
+ *
+ *       The event itself is the handle used for cancelling.
+ */
+
+
+#ifndef _RDT_EVENT_H_
+#define _RDT_EVENT_H_
+
+#include <stddef.h>
+#include <vector>
+
+
+/* simulation event base class */
+class Event
+{
+public:
+    double sched_time;      /* scheduled occuring time */
+    int event_type;         /* application-specific event type */
+    class Event *next;      /* next event in the chain */
+    class Event *prev;      /* previous event in the chain (wheel only) */
+    unsigned long long seq; /* scheduling order, breaks ties on sched_time */
+    int qpos;               /* queue-specific position, -1 if not queued */
+
+public:
+    Event() { next = NULL; prev = NULL; seq = 0; qpos = -1; }
+};
+
+/* the interface every event queue engine implements */
+class EventQueue
+{
+public:
+    virtual ~EventQueue() {}
+
+    /* insert an event, sched_time and seq are already filled in */
+    virtual void push(Event *e) = 0;
+
+    /* remove a queued event */
+    virtual void remove(Event *e) = 0;
+
+    /* remove and return the earliest event, NULL if the queue is empty */
+    virtual Event *pop() = 0;
+
+    virtual size_t size() const = 0;
+    virtual const char *name() const = 0;
+};
+
+/* create an event queue by name ("list", "heap", "heap4" or "wheel"),
+   tick is the slot granularity of the wheel (in seconds).
+   return NULL if the name is unknown */
+EventQueue *EventQueue_Create(const char *kind, double tick);
+
+/* event chain class - the simulation core */
+class EventChain
+{
+public:
+    double sim_time;        /* simulation time */
+    EventQueue *queue;      /* pending events */
+    unsigned long long next_seq;
+    unsigned long long processed;   /* events taken off the queue */
+
+public:
+    EventChain(EventQueue *q = NULL) {
+        sim_time = 0;
+        queue = q;
+        next_seq = 0;
+        processed = 0;
+    }
+    ~EventChain() { delete queue; }
+
+    double time() { return sim_time; }
+
+    /* schedule an event */
+    void schedule(Event *e) {
+        /* do nothing if the event is schedule for the past */
+        if (e->sched_time<sim_time) return;
+
+        e->seq = next_seq++;
+        queue->push(e);
+    }
+
+    /* cancel an event scheduled for happening in the future */
+    void cancel(Event *e) {
+        if (e->qpos>=0) queue->remove(e);
+    }
+
+    /* advance to the next event */
+    Event *next_event() {
+        Event *e = queue->pop();
+        if (e==NULL) return NULL;
+
+        sim_time = e->sched_time;
+        processed++;
+        return e;
+    }
+};
+
+
+/*[]------------------------------------------------------------------------[]
+  |  event queue engines
+  []------------------------------------------------------------------------[]*/
+
+/* the original sorted linked list */
+class ListEventQueue : public EventQueue
+{
+public:
+    ListEventQueue() { head = NULL; count = 0; }
+
+    void push(Event *e);
+    void remove(Event *e);
+    Event *pop();
+    size_t size() const { return count; }
+    const char *name() const { return "list"; }
+
+private:
+    Event *head;
+    size_t count;
+};
+
+/* d-ary min-heap ordered on (sched_time, seq), qpos is the heap index */
+template <int D>
+class HeapEventQueue : public EventQueue
+{
+public:
+    void push(Event *e);
+    void remove(Event *e);
+    Event *pop();
+    size_t size() const { return heap.size(); }
+    const char *name() const { return D==2 ? "heap" : "heap4"; }
+
+private:
+    std::vector<Event*> heap;
+
+    void place(Event *e, size_t i) { heap[i] = e; e->qpos = (int)i; }
+    void sift_up(size_t i);
+    void sift_down(size_t i);
+};
+
+/* hierarchical timer wheel: WHEEL_LEVELS levels of WHEEL_SLOTS slots, each
+   level covering WHEEL_SLOTS times the span of the level below it.
+   an event is parked at the lowest level on which its tick and the current
+   tick share the higher digits, and cascades down as the wheel turns.
+   events of the current tick are kept in a sorted due list. */
+class WheelEventQueue : public EventQueue
+{
+public:
+    WheelEventQueue(double tick);
+
+    void push(Event *e);
+    void remove(Event *e);
+    Event *pop();
+    size_t size() const { return count; }
+    const char *name() const { return "wheel"; }
+
+private:
+    enum { WHEEL_BITS = 8, WHEEL_SLOTS = 1 << WHEEL_BITS, WHEEL_LEVELS = 4,
+           WHEEL_WORDS = WHEEL_SLOTS / 64 };
+    /* qpos values of the two lists living outside the wheel */
+    enum { POS_DUE = WHEEL_LEVELS * WHEEL_SLOTS, POS_OVERFLOW };
+
+    double tick;                /* slot granularity (in seconds) */
+    unsigned long long cur;     /* current tick */
+    size_t count;
+
+    /* circular lists with sentinel heads, so unlinking is O(1) */
+    Event slots[WHEEL_LEVELS][WHEEL_SLOTS];
+    unsigned long long bitmap[WHEEL_LEVELS][WHEEL_WORDS];
+    Event due;                  /* events of the current tick, sorted */
+    Event overflow;             /* events beyond the reach of the wheel */
+
+    unsigned long long tick_of(Event *e);
+    void place(Event *e);
+    void insert_due(Event *e);
+    int find_slot(int level, int from);
+    void advance();
+};
+
+#endif  /* _RDT_EVENT_H_ */
@@ -0,0 +1,137 @@
+/*
+ * FILE: rdt_fec.h
+ * DESCRIPTION: Forward error correction by XOR parity.  Sequence numbers are
+ *       grouped into blocks of k (a power of two, so blocks line up across
+ *       the wrap of the sequence numbers).  Once the sender has sent the
+ *       first n packets of a block it may send a parity packet carrying
+ *       the XOR of their payload sizes, end flags and payloads; the
+ *       receiver rebuilds any one of the n it misses from the parity and
+ *       the other n-1, without waiting a round trip for the resend.
+ *
+ *       A parity packet is told apart from data by a payload size of 0:
+ *
+ *       |<- header ->|<- 1 byte ->|<- 2 bytes ->|<- 1 byte ->|<- the rest ->|
+ *       |  size 0,   |     n      |   XOR of    |  XOR of    |  XOR of the  |
+ *       | block start|            |   sizes     |  end flags |  payloads    |
+ *
+ *       the payloads XORed as far as the longest of them, so data packets
+ *       carry FEC_OVERHEAD bytes less payload, letting the parity of full
+ *       packets fit in one.
+ */
+
+
+#ifndef _RDT_FEC_H_
+#define _RDT_FEC_H_
+
+#include <string.h>
+#include <stdint.h>
+#include <vector>
+
+#include "rdt_struct.h"
+
+const int FEC_OVERHEAD = 4;
+const int FEC_BLOCK_MAX = 64;
+
+
+/* the XOR of the packets seen of a block, and which ones they were */
+class FecBlock
+{
+public:
+    bool live;                  /* holds a block at all */
+    uint32_t start;             /* first sequence number of the block */
+    uint64_t mask;              /* bit i: packet start+i is in */
+    int count;
+    int longest;                /* payload bytes data_xor covers */
+    u_int16_t size_xor;
+    u_int8_t flag_xor;
+    std::vector<u_int8_t> data_xor;
+
+public:
+    FecBlock() { live = false; start = 0; mask = 0; count = 0; longest = 0;
+                 size_xor = 0; flag_xor = 0; }
+
+    void reset(uint32_t start, int max_payload) {
+        live = true;
+        this->start = start;
+        mask = 0;
+        count = 0;
+        longest = 0;
+        size_xor = 0;
+        flag_xor = 0;
+        data_xor.assign(max_payload, 0);
+    }
+
+    bool has(int index) const { return (mask>>index) & 1; }
+
+    /* fold in packet start+index */
+    void add(int index, int size, bool end_flag, const char *payload) {
+        mask |= (uint64_t)1<<index;
+        count++;
+        fold(size, end_flag, payload);
+    }
+
+    /* take packet start+index out again */
+    void remove(int index, int size, bool end_flag, const char *payload) {
+        mask &= ~((uint64_t)1<<index);
+        count--;
+        fold(size, end_flag, payload);
+    }
+
+    /* write the parity of the first n packets after a header of
+       header_size bytes, return the bytes written */
+    int put_parity(struct packet *pkt, int header_size, int n) const {
+        u_int8_t *p = (u_int8_t*)pkt->data + header_size;
+        p[0] = (u_int8_t)n;
+        p[1] = (u_int8_t)(size_xor >> 8);
+        p[2] = (u_int8_t)size_xor;
+        p[3] = flag_xor;
+        memcpy(p + FEC_OVERHEAD, &data_xor[0], longest);
+        return FEC_OVERHEAD + longest;
+    }
+
+    /* take the parity a packet carries for the block at start, the parity
+       of its first count packets.  false if it runs past max_payload */
+    bool get_parity(const struct packet *pkt, int header_size, uint32_t start,
+                    int max_payload) {
+        const u_int8_t *p = (const u_int8_t*)pkt->data + header_size;
+        int len = pkt->size - header_size - FEC_OVERHEAD;
+        if (len<0 || len>max_payload) return false;
+        reset(start, max_payload);
+        count = p[0];
+        size_xor = (u_int16_t)((p[1] << 8) | p[2]);
+        flag_xor = p[3];
+        memcpy(&data_xor[0], p + FEC_OVERHEAD, len);
+        longest = len;
+        return true;
+    }
+
+    /* the one packet among the first n missing here, -1 if none or more */
+    int missing(int n) const {
+        uint64_t want = n<64 ? ((uint64_t)1<<n)-1 : ~(uint64_t)0;
+        uint64_t lost = want & ~mask;
+        if (lost==0 || (lost & (lost-1))!=0) return -1;
+        return __builtin_ctzll(lost);
+    }
+
+    /* rebuild the missing packet from the parity of the block, return its
+       payload size, or 0 if the parity does not add up to a packet */
+    int rebuild(const FecBlock &parity, bool *end_flag, char *payload) const {
+        int size = parity.size_xor ^ size_xor;
+        if (size==0 || size>(int)data_xor.size()) return 0;
+        *end_flag = (parity.flag_xor ^ flag_xor) & 1;
+        for (int i = 0; i<size; i++)
+            payload[i] = (char)(parity.data_xor[i] ^ data_xor[i]);
+        return size;
+    }
+
+private:
+    void fold(int size, bool end_flag, const char *payload) {
+        if (size>longest) longest = size;
+        size_xor ^= (u_int16_t)size;
+        flag_xor ^= end_flag ? 1 : 0;
+        for (int i = 0; i<size; i++)
+            data_xor[i] ^= (u_int8_t)payload[i];
+    }
+};
+
+#endif  /* _RDT_FEC_H_ */
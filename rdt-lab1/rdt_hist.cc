@@ -0,0 +1,42 @@
+/*
+ * FILE: rdt_hist.cc
+ * DESCRIPTION: Percentiles and the bucket dump of a Histogram.
+ */
+
+
+#include <stdio.h>
+#include <math.h>
+
+#include "rdt_hist.h"
+
+
+double Histogram::percentile(double q) const
+{
+    if (total==0) return 0;
+    uint64_t rank = (uint64_t)ceil(q*total);
+    if (rank<1) rank = 1;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i<counts.size(); i++) {
+        seen += counts[i];
+        if (seen>=rank) {
+            /* the top of the bucket, but no further than the largest seen */
+            double top = (lower(i)+width(i))*1e-6;
+            return top<most ? top : most;
+        }
+    }
+    return most;
+}
+
+void Histogram::dump(FILE *f) const
+{
+    fprintf(f, "lower,upper,count,cumulative\n");
+    uint64_t seen = 0;
+    for (size_t i = 0; i<counts.size(); i++) {
+        if (counts[i]==0) continue;
+        seen += counts[i];
+        fprintf(f, "%.6f,%.6f,%llu,%llu\n", lower(i)*1e-6,
+                (lower(i)+width(i))*1e-6, (unsigned long long)counts[i],
+                (unsigned long long)seen);
+    }
+}
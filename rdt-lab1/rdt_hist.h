@@ -0,0 +1,76 @@
+/*
+ * FILE: rdt_hist.h
+ * DESCRIPTION: A histogram of durations with log-linear buckets, after
+ *       HdrHistogram: values are counted in microseconds, exactly below
+ *       2^SUB_BITS and beyond that in 2^SUB_BITS buckets per power of two,
+ *       so any value is known to within 2^-SUB_BITS of itself (1.6%) from
+ *       a microsecond up, in a few thousand counters at most.
+ */
+
+
+#ifndef _RDT_HIST_H_
+#define _RDT_HIST_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+
+class Histogram
+{
+public:
+    enum { SUB_BITS = 6 };
+
+public:
+    Histogram() { total = 0; sum = 0; least = 0; most = 0; }
+
+    /* count a duration (in seconds) */
+    void add(double seconds) {
+        uint64_t v = seconds>0 ? (uint64_t)(seconds*1e6) : 0;
+        size_t i = index(v);
+        if (i>=counts.size()) counts.resize(i+1, 0);
+        counts[i]++;
+        if (total==0 || seconds<least) least = seconds;
+        if (total==0 || seconds>most) most = seconds;
+        total++;
+        sum += seconds;
+    }
+
+    uint64_t count() const { return total; }
+    double mean() const { return total>0 ? sum/total : 0; }
+    double min() const { return least; }
+    double max() const { return most; }
+
+    /* the least duration at or below which a fraction q of them lie, to
+       the precision of the buckets (in seconds) */
+    double percentile(double q) const;
+
+    /* write the buckets counted as CSV rows of
+       lower,upper,count,cumulative (in seconds, upper exclusive) */
+    void dump(FILE *f) const;
+
+private:
+    std::vector<uint64_t> counts;
+    uint64_t total;
+    double sum;
+    double least;
+    double most;
+
+    static size_t index(uint64_t v) {
+        if (v<((uint64_t)1<<SUB_BITS)) return (size_t)v;
+        int shift = 63-__builtin_clzll(v)-SUB_BITS;
+        return ((size_t)(shift+1)<<SUB_BITS) + (size_t)((v>>shift)-((uint64_t)1<<SUB_BITS));
+    }
+
+    /* the microseconds bucket i starts at, and how many it spans */
+    static uint64_t lower(size_t i) {
+        if (i<((size_t)1<<SUB_BITS)) return i;
+        int shift = (int)(i>>SUB_BITS)-1;
+        return (((uint64_t)1<<SUB_BITS) + (i & (((size_t)1<<SUB_BITS)-1))) << shift;
+    }
+    static uint64_t width(size_t i) {
+        return i<((size_t)1<<SUB_BITS) ? 1 : (uint64_t)1<<((i>>SUB_BITS)-1);
+    }
+};
+
+#endif  /* _RDT_HIST_H_ */
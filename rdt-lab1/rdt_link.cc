@@ -0,0 +1,177 @@
+/*
+ * FILE: rdt_link.cc
+ * DESCRIPTION: The bottleneck, loss and delay models of a link direction.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "rdt_link.h"
+
+
+/* RED (Floyd and Jacobson): the weight of a new sample in the average
+   queue, and the drop probability the average reaches at the upper
+   threshold.  the thresholds are a quarter and three quarters of the
+   queue */
+static const double RED_WEIGHT = 0.002;
+static const double RED_MAX_P = 0.1;
+
+Link::Link()
+{
+    memset(&cfg, 0, sizeof(cfg));
+    loss_rate = 0;
+    outoforder_rate = 0;
+    latency = 0;
+    bad = false;
+    busy_until = 0;
+    red_avg = 0;
+    departure = 0;
+    offered = 0;
+    forced_drops = 0;
+    early_drops = 0;
+    losses = 0;
+    bad_packets = 0;
+    queue_high = 0;
+    sent = 0;
+    sojourn_sum = 0;
+}
+
+void Link::setup(const struct link_config *cfg, double loss_rate,
+                 double outoforder_rate, double latency)
+{
+    this->cfg = *cfg;
+    this->loss_rate = loss_rate;
+    this->outoforder_rate = outoforder_rate;
+    this->latency = latency;
+}
+
+/* queue a packet for the bottleneck, return false if it is dropped */
+bool Link::admit(Random *rng, double now, int size)
+{
+    /* the packets the line has sent by now have left */
+    while (!departures.empty() && departures.front()<=now)
+        departures.pop_front();
+    int queued = (int)departures.size();
+
+    if (cfg.aqm==LINK_RED) {
+        /* an idle line lets the average decay as if packets of this size
+           had found the queue empty all along */
+        if (queued==0 && now>busy_until)
+            red_avg *= pow(1-RED_WEIGHT, (now-busy_until)*cfg.rate/size);
+        else
+            red_avg = (1-RED_WEIGHT)*red_avg + RED_WEIGHT*queued;
+
+        double min_th = 0.25*cfg.queue_limit, max_th = 0.75*cfg.queue_limit;
+        if (queued<cfg.queue_limit && red_avg>min_th
+            && (red_avg>=max_th
+                || rng->uniform()<RED_MAX_P*(red_avg-min_th)/(max_th-min_th))) {
+            early_drops++;
+            return false;
+        }
+    }
+    if (queued>=cfg.queue_limit) {
+        forced_drops++;
+        return false;
+    }
+
+    departure = (busy_until>now ? busy_until : now) + size/cfg.rate;
+    busy_until = departure;
+    departures.push_back(departure);
+    if (queued+1>queue_high) queue_high = queued+1;
+    sent++;
+    sojourn_sum += departure-now;
+    return true;
+}
+
+bool Link::offer(Random *rng, double now, int size)
+{
+    offered++;
+    departure = now;
+    if (cfg.rate>0 && !admit(rng, now, size)) return false;
+
+    double loss = loss_rate;
+    if (cfg.burst) {
+        if (rng->uniform()<(bad ? cfg.burst_r : cfg.burst_p)) bad = !bad;
+        if (bad) {
+            bad_packets++;
+            loss = cfg.burst_h;
+        }
+    }
+    if (rng->uniform()<loss) {
+        losses++;
+        return false;
+    }
+    return true;
+}
+
+double Link::arrival(Random *rng)
+{
+    double delay = latency;
+    switch (cfg.delay_kind) {
+    case DELAY_CLASSIC:
+        if (rng->uniform()<outoforder_rate)
+            delay = latency*2.0*rng->uniform();
+        break;
+    case DELAY_UNIFORM:
+        delay += cfg.jitter*(2.0*rng->uniform()-1);
+        break;
+    case DELAY_NORMAL:
+        delay += cfg.jitter*rng->normal();
+        break;
+    case DELAY_EXP:
+        delay += rng->exponential(cfg.jitter);
+        break;
+    }
+    return departure + (delay>0 ? delay : 0);
+}
+
+void Link::report(FILE *f, const char *name) const
+{
+    fprintf(f, "\t%-8s %d packets offered, %d dropped by the queue (%d early), "
+            "%d lost\n", name, offered, forced_drops+early_drops, early_drops,
+            losses);
+    if (cfg.rate>0)
+        fprintf(f, "\t%-8s queue high water %d packets, mean sojourn %.4fs\n",
+                "", queue_high, sent>0 ? sojourn_sum/sent : 0);
+    if (cfg.burst)
+        fprintf(f, "\t%-8s %d packets offered in the bad state\n", "",
+                bad_packets);
+}
+
+int LinkAqm(const char *name)
+{
+    if (strcmp(name, "droptail")==0) return LINK_DROPTAIL;
+    if (strcmp(name, "red")==0) return LINK_RED;
+    return -1;
+}
+
+int LinkDelayKind(const char *name)
+{
+    static const char *const names[] = {"classic", "uniform", "normal", "exp"};
+    for (int i = 0; i<(int)(sizeof(names)/sizeof(names[0])); i++)
+        if (strcmp(name, names[i])==0) return i;
+    return -1;
+}
+
+void Link_Describe(const struct link_config *cfg, char *buf, size_t len)
+{
+    static const char *const delays[] = {"classic", "uniform", "normal",
+                                         "exponential"};
+    int n = 0;
+    if (cfg->rate>0)
+        n = snprintf(buf, len, "%.0f bytes/s behind a %s queue of %d packets",
+                     cfg->rate, cfg->aqm==LINK_RED ? "RED" : "drop-tail",
+                     cfg->queue_limit);
+    else
+        n = snprintf(buf, len, "unlimited");
+    if (n<(int)len && cfg->burst)
+        n += snprintf(buf+n, len-n, ", burst loss (p %g, r %g, h %g)",
+                      cfg->burst_p, cfg->burst_r, cfg->burst_h);
+    if (n<(int)len && cfg->delay_kind==DELAY_CLASSIC)
+        snprintf(buf+n, len-n, ", classic delay");
+    else if (n<(int)len)
+        snprintf(buf+n, len-n, ", %s jitter of %.3fs",
+                 delays[cfg->delay_kind], cfg->jitter);
+}
@@ -0,0 +1,111 @@
+/*
+ * FILE: rdt_link.h
+ * DESCRIPTION: The model of one direction of the link between the sender
+ *       and the receiver.  A packet put on the link goes through
+ *
+ *       bottleneck - a queue of up to queue_limit packets in front of a
+ *                    line of rate bytes per second, dropping arrivals when
+ *                    full (drop-tail) or early, with a probability rising
+ *                    with the average queue (RED).  the queue holds the
+ *                    packet until the line has sent the packets ahead of it
+ *                    and the packet itself
+ *       loss       - i.i.d. at loss_rate, or Gilbert-Elliott bursts: the
+ *                    channel moves from the good state to the bad with
+ *                    probability p and back with r on each packet, losing
+ *                    loss_rate of the packets in the good state and h of
+ *                    them in the bad
+ *       delay      - the propagation delay after the packet leaves the
+ *                    bottleneck: latency, or with probability
+ *                    outoforder_rate anything in [0, 2*latency] (classic),
+ *                    or latency plus jitter drawn from a uniform, normal or
+ *                    exponential distribution of the given spread
+ *
+ *       With no bottleneck and the classic delay the link draws the random
+ *       numbers it always has, so runs are unchanged from before the model.
+ *       Corruption is left to the caller, between the loss and the delay.
+ */
+
+
+#ifndef _RDT_LINK_H_
+#define _RDT_LINK_H_
+
+#include <stdio.h>
+#include <deque>
+
+#include "rdt_random.h"
+
+
+enum {LINK_DROPTAIL=0, LINK_RED};
+enum {DELAY_CLASSIC=0, DELAY_UNIFORM, DELAY_NORMAL, DELAY_EXP};
+
+/* the parameters of the link, both directions alike */
+struct link_config {
+    double rate;                /* bottleneck in bytes/s, 0 for none */
+    int queue_limit;            /* packets the bottleneck queue holds */
+    int aqm;                    /* LINK_DROPTAIL or LINK_RED */
+
+    bool burst;                 /* Gilbert-Elliott rather than i.i.d. loss */
+    double burst_p;             /* good to bad, per packet */
+    double burst_r;             /* bad to good, per packet */
+    double burst_h;             /* loss in the bad state */
+
+    int delay_kind;             /* DELAY_CLASSIC, ... */
+    double jitter;              /* spread of the jitter (in seconds) */
+};
+
+class Link
+{
+public:
+    Link();
+
+    /* take the parameters, the loss and out-of-order rates of the good
+       channel and the mean propagation delay (in seconds) */
+    void setup(const struct link_config *cfg, double loss_rate,
+               double outoforder_rate, double latency);
+
+    /* offer a packet of size bytes at time now, return false if the queue
+       or the channel drops it */
+    bool offer(Random *rng, double now, int size);
+
+    /* the time the packet just offered arrives at the far end */
+    double arrival(Random *rng);
+
+    /* print the counters with name as the heading */
+    void report(FILE *f, const char *name) const;
+
+    /* packets dropped by the queue, by the channel */
+    int queue_drops() const { return forced_drops+early_drops; }
+    int channel_losses() const { return losses; }
+
+private:
+    struct link_config cfg;
+    double loss_rate;
+    double outoforder_rate;
+    double latency;
+
+    bool bad;                   /* Gilbert-Elliott state */
+    std::deque<double> departures;  /* of the packets in the queue */
+    double busy_until;          /* when the line has sent them all */
+    double red_avg;             /* average queue, in packets */
+    double departure;           /* of the packet just offered */
+
+    int offered;
+    int forced_drops;           /* arrivals finding the queue full */
+    int early_drops;            /* ... dropped early by RED */
+    int losses;
+    int bad_packets;            /* offered in the bad state */
+    int queue_high;
+    int sent;                   /* packets through the bottleneck */
+    double sojourn_sum;         /* their time in the queue, sending included */
+
+    bool admit(Random *rng, double now, int size);
+};
+
+/* parse a --aqm or --delay value, -1 if invalid */
+int LinkAqm(const char *name);
+int LinkDelayKind(const char *name);
+
+/* describe the link for the banner of a run */
+void Link_Describe(const struct link_config *cfg, char *buf, size_t len);
+
+#endif  /* _RDT_LINK_H_ */
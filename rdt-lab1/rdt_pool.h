@@ -0,0 +1,101 @@
+/*
+ * FILE: rdt_pool.h
+ * DESCRIPTION: Typed free-list allocator for simulation events.
+ *       Events are carved out of fixed-size chunks and recycled through a
+ *       free list threaded through the released storage, so once the pool
+ *       has grown to the high-water mark of the run no more heap calls are
+ *       made.  Each event may be followed by a fixed number of trailing
+ *       bytes of its own, such as the packet a link event carries.
+ */
+
+
+#ifndef _RDT_POOL_H_
+#define _RDT_POOL_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+#include <vector>
+
+#include "rdt_event.h"
+
+
+template <class T>
+class EventPool
+{
+public:
+    enum { CHUNK_SIZE = 256 };  /* events per chunk */
+
+    const char *name;
+    size_t in_use;              /* events currently handed out */
+    size_t high_water;          /* the largest in_use seen so far */
+
+public:
+    EventPool(const char *name, size_t trailer_size = 0) {
+        this->name = name;
+        stride = (sizeof(T)+trailer_size+alignof(T)-1)/alignof(T)*alignof(T);
+        in_use = 0;
+        high_water = 0;
+        free_list = NULL;
+        carved = CHUNK_SIZE;
+    }
+
+    ~EventPool() {
+        for (size_t i = 0; i<chunks.size(); i++)
+            free(chunks[i]);
+    }
+
+    /* get a freshly constructed event */
+    T *alloc() {
+        void *mem;
+        if (free_list!=NULL) {
+            mem = free_list;
+            free_list = free_list->next;
+        }
+        else {
+            if (carved==CHUNK_SIZE) {
+                chunks.push_back((char*) malloc(stride*CHUNK_SIZE));
+                if (chunks.back()==NULL) {
+                    fprintf(stderr, "out of memory for %s events\n", name);
+                    exit(-1);
+                }
+                carved = 0;
+            }
+            mem = chunks.back() + stride*carved++;
+        }
+
+        if (++in_use>high_water) high_water = in_use;
+        return new (mem) T;
+    }
+
+    /* return an event to the pool, it must not be queued any more */
+    void release(T *e) {
+        e->~T();
+        FreeSlot *slot = new (e) FreeSlot;
+        slot->next = free_list;
+        free_list = slot;
+        in_use--;
+    }
+
+    /* the trailing bytes of an event */
+    static char *trailer(T *e) { return (char*)(e+1); }
+
+    /* the number of chunks taken from the heap */
+    size_t nchunks() const { return chunks.size(); }
+
+    void report(FILE *fp) const {
+        fprintf(fp, "\t%-26s high water %zu events, %zu chunks (%zu bytes)\n",
+                name, high_water, chunks.size(),
+                chunks.size()*CHUNK_SIZE*stride);
+    }
+
+private:
+    struct FreeSlot { FreeSlot *next; };
+
+    FreeSlot *free_list;        /* recycled events */
+    std::vector<char*> chunks;  /* the arena */
+    size_t carved;              /* events handed out of the last chunk */
+    size_t stride;              /* bytes per event, its trailer included */
+};
+
+#endif  /* _RDT_POOL_H_ */
@@ -0,0 +1,85 @@
+/*
+ * FILE: rdt_random.h
+ * DESCRIPTION: Per-simulation random number generator.  xoshiro256** seeded
+ *       through splitmix64, so a seed fully determines a run.  Uniform
+ *       variates are pre-generated a block at a time into a buffer; the
+ *       link draws 3-4 of them per packet, and refilling in bulk keeps the
+ *       generator loop tight and out of the event handlers.  Batching does
+ *       not change the stream: the n-th variate is the same either way.
+ *       Normal and exponential variates are derived from the uniform ones.
+ */
+
+
+#ifndef _RDT_RANDOM_H_
+#define _RDT_RANDOM_H_
+
+#include <stdint.h>
+#include <math.h>
+
+
+class Random
+{
+public:
+    enum { BATCH = 256 };       /* variates generated per refill */
+
+public:
+    Random(uint64_t seed = 0) { seed_with(seed); }
+
+    void seed_with(uint64_t seed) {
+        /* splitmix64 spreads the seed over the whole state */
+        for (int i = 0; i<4; i++) {
+            seed += 0x9e3779b97f4a7c15ULL;
+            uint64_t z = seed;
+            z = (z ^ (z>>30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z>>27)) * 0x94d049bb133111ebULL;
+            s[i] = z ^ (z>>31);
+        }
+        pos = BATCH;
+    }
+
+    /* the next raw 64-bit output */
+    uint64_t next() {
+        uint64_t result = rotl(s[1]*5, 7) * 9;
+        uint64_t t = s[1]<<17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+
+    /* a uniform variate in [0,1), served from the pre-generated block */
+    double uniform() {
+        if (pos==BATCH) refill();
+        return batch[pos++];
+    }
+
+    /* a standard normal variate, by Box-Muller with the first uniform
+       variate kept off 0 */
+    double normal() {
+        double u = 1-uniform();
+        return sqrt(-2*log(u))*cos(2*M_PI*uniform());
+    }
+
+    /* an exponential variate of the given mean */
+    double exponential(double mean) {
+        return -mean*log(1-uniform());
+    }
+
+private:
+    uint64_t s[4];
+    double batch[BATCH];
+    int pos;                    /* next unused variate in batch */
+
+    static uint64_t rotl(uint64_t x, int k) { return (x<<k) | (x>>(64-k)); }
+
+    void refill() {
+        for (int i = 0; i<BATCH; i++)
+            batch[i] = (next()>>11) * (1.0/9007199254740992.0);
+        pos = 0;
+    }
+};
+
+#endif  /* _RDT_RANDOM_H_ */
@@ -1,119 +1,343 @@
 /*
  * FILE: rdt_receiver.cc
  * DESCRIPTION: Reliable data transfer receiver.
- * NOTE: This implementation assumes there is no packet loss, corruption, or 
- *       reordering.  You will need to enhance it to deal with all these 
- *       situations.  In this implementation, the packet format is laid out as 
- *       the following:
- *       
- *       |<-  1 byte  ->|<-             the rest            ->|
- *       | payload size |<-             payload             ->|
- *
- *       The first byte of each packet indicates the size of the payload
- *       (excluding this single-byte header)
+ * NOTE: Packets within the window of sim->cfg.window_size packets are
+ *       buffered until they can be delivered in order, and acknowledged
+ *       cumulatively.  The packet header is laid out in utils.h.
+ *       In-order payloads are copied straight into a reassembly buffer
+ *       reused from message to message, which the upper layer is handed
+ *       once the message is complete.  Out-of-order payloads wait in a
+ *       fixed slot of the window: their place in the message is not known
+ *       until the gap before them fills, as a message may end in it.
+ *       With coalescing, the payload is a run of message chunks, each handed
+ *       on to reassembly by itself.
+ *       With forward error correction, a packet missing from a block is
+ *       rebuilt from the parity of the block and the packets received.
  */
 
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <list>
+#include <vector>
 #include "rdt_struct.h"
 #include "rdt_receiver.h"
+#include "rdt_sim.h"
+#include "rdt_fec.h"
 #include "utils.h"
 
-static struct message * recv_buffer[SEQ_SIZE];
-static bool             flag_buffer[SEQ_SIZE];
-static std::list<struct message*> message_factory;
+struct ReceiverState{
+    /* the window is a ring of window_size slots, buffer_head holds
+       next_frame_expected, sequence numbers wrap around at seq_size */
+    int window_size;
+    uint64_t seq_size;
 
-static seq_nr_t next_frame_expected = 0;
+    /* the payload of an out-of-order packet held in each slot, its size (0
+       if the slot is empty) and its end flag */
+    int slot_payload;
+    std::vector<char> slot_data;
+    std::vector<int>  slot_size;
+    std::vector<bool> flag_buffer;
+    int buffer_head;
 
-static void acknowledge(seq_nr_t seq_num){
+    /* the message being reassembled, msg_len bytes so far.  the buffer
+       doubles when it runs out of room and is kept for the next message */
+    char *msg_buf;
+    int msg_len;
+    int msg_cap;
+
+    seq_nr_t next_frame_expected;
+
+    /* in-order packets delivered since the last ack, whose ack is delayed
+       to be coalesced with the ones following them */
+    int unacked;
+
+    /* forward error correction: the XOR of the packets accepted into the
+       window and the parity received, for each block the window overlaps,
+       a ring of fec_nblocks (a power of two) indexed by block number.  a
+       block is dropped once delivered in full */
+    int fec_block;
+    int fec_nblocks;
+    int fec_payload;
+    std::vector<FecBlock> fec_acc;
+    std::vector<FecBlock> fec_parity;
+};
+
+/* record an event of the receiver into the trace ring, with the sequence
+   number expected next and the in-order packets not acked yet */
+#define RECEIVER_RECORD(sim, event, seq) \
+    RDT_RECORD(sim, event, seq, (int)(sim)->receiver->next_frame_expected, \
+               (sim)->receiver->unacked)
+
+/* ack seq_num, the packet just before next_frame_expected */
+static void acknowledge(Simulation *sim, seq_nr_t seq_num){
+    ReceiverState *r = sim->receiver;
+    int check_width = sim->cfg.check_width;
+    int size_width = sim->cfg.size_width;
+    int header_size = HeaderSize(sim->cfg.seq_width, check_width, size_width, sim->cfg.conn_width);
+    char buf[RDT_PKTSIZE_MAX];
     packet pkt;
-    pkt.data[2] = 0;
-    pkt.data[3] = seq_num;
+    pkt.data = buf;
+    memset(buf, 0, header_size);
+    PutSeq(&pkt, check_width, size_width, sim->cfg.seq_width, seq_num, false);
+    PutConn(&pkt, check_width, size_width, sim->cfg.seq_width, sim->cfg.conn_width, sim->conn->id);
+
+    /* a selective ack maps the packets held past next_frame_expected, as far
+       as the payload reaches */
+    int nbytes = 0;
+    if(sim->cfg.sack){
+        u_int8_t *bitmap = (u_int8_t*)pkt.data + header_size;
+        int nbits = 8 * r->slot_payload;
+        if(nbits > r->window_size - 1) nbits = r->window_size - 1;
+        memset(bitmap, 0, (nbits + 7) / 8);
+        for(int i = 0; i < nbits; i++){
+            if(r->slot_size[(r->buffer_head + 1 + i) % r->window_size] == 0) continue;
+            bitmap[i / 8] |= 0x80 >> (i % 8);
+            nbytes = i / 8 + 1;
+        }
+    }
+    PutSize(&pkt, check_width, size_width, nbytes);
+    pkt.size = header_size + nbytes;
+
     /* calculate checksum */
-    *((u_int16_t*)pkt.data) = chksum(pkt.data + 2, 2);
-    Receiver_ToLowerLayer(&pkt);
+    PutCheck(&pkt, sim->cfg.check_kind, pkt.size);
+    RECEIVER_RECORD(sim, TRACE_ACK_SEND, seq_num);
+    Receiver_ToLowerLayer(sim, &pkt);
+    GetStats(sim)->acks_sent++;
+
+    /* the ack covers every packet delivered so far */
+    r->unacked = 0;
+    if(Receiver_isTimerSet(sim)) Receiver_StopTimer(sim);
 }
 
-static void Receiver_SubmitMsg(struct message* message, bool end_flag){
-    ASSERT(message!=NULL);
+/* append an in-order payload to the message being reassembled, and hand
+   the message to the upper layer if the payload ends it */
+static void Receiver_SubmitMsg(Simulation *sim, const char *data, int size, bool end_flag){
+    ReceiverState *r = sim->receiver;
+    ASSERT(size > 0);
+    if(r->msg_len + size > r->msg_cap){
+        int cap = r->msg_cap > 0 ? r->msg_cap : RDT_PKTSIZE;
+        while(cap < r->msg_len + size) cap *= 2;
+        r->msg_buf = (char*)realloc(r->msg_buf, cap);
+        ASSERT(r->msg_buf!=NULL);
+        r->msg_cap = cap;
+    }
+    memcpy(r->msg_buf + r->msg_len, data, size);
+    r->msg_len += size;
+
     if(end_flag){
-        int size = 0;
-        /* calculate total size */
-        for(auto& item:message_factory){
-            size += item->size;
-        }
-        size += message->size;
-
-        /* Construct a message */
-        struct message *msg = (struct message*) malloc(sizeof(struct message));
-        ASSERT(msg!=NULL);
-        msg->size = size;
-        msg->data = (char*)malloc(size);
-        ASSERT(msg->data!=NULL);
-        
-        /* Copy all data in order */
-        int cursor = 0;
-        for(auto& item:message_factory){
-            memcpy(msg->data + cursor, item->data, item->size);
-            cursor += item->size; 
-            free(item->data);
-            free(item);
+        struct message msg;
+        msg.size = r->msg_len;
+        msg.data = r->msg_buf;
+        Receiver_ToUpperLayer(sim, &msg);
+        r->msg_len = 0;
+    }
+}
+
+/* take the payload of the next packet in order */
+static void Receiver_SubmitPayload(Simulation *sim, const char *data, int size, bool end_flag){
+    if(!sim->cfg.coalesce){
+        Receiver_SubmitMsg(sim, data, size, end_flag);
+        return;
+    }
+    int off = 0;
+    while(off + CHUNK_HEADER <= size){
+        bool chunk_end;
+        int len = GetChunkHeader(data + off, &chunk_end);
+        /* only a corruption the check missed runs off the payload, the
+           message verification will tell */
+        if(len == 0 || off + CHUNK_HEADER + len > size) break;
+        Receiver_SubmitMsg(sim, data + off + CHUNK_HEADER, len, chunk_end);
+        off += CHUNK_HEADER + len;
+    }
+}
+
+/* the ring index of the block at start */
+static int Receiver_FecIndex(ReceiverState *r, seq_nr_t start){
+    return (start / r->fec_block) & (r->fec_nblocks - 1);
+}
+
+/* the XOR of the packets of the block at start accepted so far */
+static FecBlock &Receiver_FecAcc(ReceiverState *r, seq_nr_t start){
+    FecBlock &acc = r->fec_acc[Receiver_FecIndex(r, start)];
+    if(!acc.live || acc.start != start) acc.reset(start, r->fec_payload);
+    return acc;
+}
+
+/* fold a packet accepted into the window into its block */
+static void Receiver_FecAdd(ReceiverState *r, seq_nr_t seq_num, int size, bool end_flag, const char *payload){
+    int index = seq_num % r->fec_block;
+    FecBlock &acc = Receiver_FecAcc(r, seq_num - index);
+    if(!acc.has(index)) acc.add(index, size, end_flag, payload);
+}
+
+/* move past next_frame_expected, dropping its block if that completes it */
+static void Receiver_Advance(Simulation *sim){
+    ReceiverState *r = sim->receiver;
+    incNum(r->next_frame_expected, r->seq_size);
+    r->buffer_head = (r->buffer_head + 1) % r->window_size;
+    if(r->fec_block > 0 && r->next_frame_expected % r->fec_block == 0){
+        int index = Receiver_FecIndex(r, addNum(r->next_frame_expected, r->seq_size - r->fec_block, r->seq_size));
+        r->fec_acc[index].live = false;
+        r->fec_parity[index].live = false;
+    }
+}
+
+/* rebuild the one packet the block at start misses, if its parity is in,
+   and take it as if it came from the link */
+static void Receiver_FecRecover(Simulation *sim, seq_nr_t start){
+    ReceiverState *r = sim->receiver;
+    const FecBlock &parity = r->fec_parity[Receiver_FecIndex(r, start)];
+    if(!parity.live || parity.start != start) return;
+    FecBlock &acc = Receiver_FecAcc(r, start);
+    int index = acc.missing(parity.count);
+    if(index < 0) return;
+    seq_nr_t seq_num = addNum(start, index, r->seq_size);
+    if(!between(r->next_frame_expected, seq_num, addNum(r->next_frame_expected, r->window_size, r->seq_size), r->seq_size))
+        return;
+
+    /* a parity cut short leaves out the packets past its count.  those
+       received are still held out of order, behind the missing one: take
+       them out of a copy of the block */
+    FecBlock covered;
+    const FecBlock *known = &acc;
+    if(parity.count < FEC_BLOCK_MAX && acc.mask >> parity.count != 0){
+        covered = acc;
+        for(int i = parity.count; i < r->fec_block; i++){
+            if(!covered.has(i)) continue;
+            int slot = (r->buffer_head + distance(r->next_frame_expected, addNum(start, i, r->seq_size), r->seq_size)) % r->window_size;
+            if(r->slot_size[slot] == 0) return;
+            covered.remove(i, r->slot_size[slot], r->flag_buffer[slot], &r->slot_data[(size_t)slot * r->slot_payload]);
         }
-        memcpy(msg->data + cursor, message->data, message->size);
-        cursor += message->size;
-        ASSERT(cursor == size);
-
-        Receiver_ToUpperLayer(msg);
-        free(msg->data);
-        free(msg);
-        message_factory.clear();
+        known = &covered;
     }
-    else{
-        message_factory.push_back(message);
+
+    int check_width = sim->cfg.check_width;
+    int size_width = sim->cfg.size_width;
+    int header_size = HeaderSize(sim->cfg.seq_width, check_width, size_width, sim->cfg.conn_width);
+    char buf[RDT_PKTSIZE_MAX];
+    packet pkt;
+    pkt.data = buf;
+    memset(buf, 0, header_size);
+    bool end_flag;
+    int size = known->rebuild(parity, &end_flag, pkt.data + header_size);
+    if(size == 0) return;
+    pkt.size = header_size + size;
+    PutSize(&pkt, check_width, size_width, size);
+    PutSeq(&pkt, check_width, size_width, sim->cfg.seq_width, seq_num, end_flag);
+    PutConn(&pkt, check_width, size_width, sim->cfg.seq_width, sim->cfg.conn_width, sim->conn->id);
+    PutCheck(&pkt, sim->cfg.check_kind, pkt.size);
+
+    RDT_TRACE(sim, "At %.2fs: packet(%d) recovered!\n", GetSimulationTime(sim), seq_num);
+    RECEIVER_RECORD(sim, TRACE_RECOVER, seq_num);
+    GetStats(sim)->fec_recovered++;
+    Receiver_FromLowerLayer(sim, &pkt);
+}
+
+/* take a parity packet for the block at start, unless all of the packets
+   it covers are delivered or it covers fewer than the parity held */
+static void Receiver_FecParity(Simulation *sim, struct packet *pkt, seq_nr_t start){
+    ReceiverState *r = sim->receiver;
+    int header_size = HeaderSize(sim->cfg.seq_width, sim->cfg.check_width, sim->cfg.size_width, sim->cfg.conn_width);
+    if(pkt->size < header_size + FEC_OVERHEAD) return;
+    int n = (u_int8_t)pkt->data[header_size];
+    if(n < 1 || n > r->fec_block || start % r->fec_block != 0) return;
+    seq_nr_t last = addNum(start, n - 1, r->seq_size);
+    if(!between(r->next_frame_expected, last, addNum(r->next_frame_expected, r->window_size, r->seq_size), r->seq_size))
+        return;
+
+    FecBlock &parity = r->fec_parity[Receiver_FecIndex(r, start)];
+    if(parity.live && parity.start == start && parity.count >= n) return;
+    if(!parity.get_parity(pkt, header_size, start, r->fec_payload)){
+        parity.live = false;
+        return;
     }
+    Receiver_FecRecover(sim, start);
 }
 
 /* receiver initialization, called once at the very beginning */
-void Receiver_Init()
+void Receiver_Init(Simulation *sim)
 {
-    fprintf(stdout, "At %.2fs: receiver initializing ...\n", GetSimulationTime());
-    for(int i = 0; i < SEQ_SIZE; i++){
-        recv_buffer[i] = NULL;
-        flag_buffer[i] = false;
+    RDT_TRACE(sim, "At %.2fs: receiver initializing ...\n", GetSimulationTime(sim));
+    ReceiverState *r = new ReceiverState;
+    r->window_size = sim->cfg.window_size;
+    r->seq_size = SeqSize(sim->cfg.seq_width);
+    r->slot_payload = sim->cfg.mtu - HeaderSize(sim->cfg.seq_width, sim->cfg.check_width, sim->cfg.size_width, sim->cfg.conn_width);
+    r->slot_data.resize((size_t)r->window_size * r->slot_payload);
+    r->slot_size.assign(r->window_size, 0);
+    r->flag_buffer.assign(r->window_size, false);
+    r->buffer_head = 0;
+    r->msg_buf = NULL;
+    r->msg_len = 0;
+    r->msg_cap = 0;
+    r->next_frame_expected = 0;
+    r->unacked = 0;
+    r->fec_block = sim->cfg.fec_block;
+    r->fec_nblocks = 0;
+    r->fec_payload = r->slot_payload - FEC_OVERHEAD;
+    if(r->fec_block > 0){
+        /* a window not aligned to blocks overlaps one more */
+        r->fec_nblocks = 1;
+        while(r->fec_nblocks < r->window_size / r->fec_block + 2) r->fec_nblocks *= 2;
+        r->fec_acc.resize(r->fec_nblocks);
+        r->fec_parity.resize(r->fec_nblocks);
     }
+    sim->receiver = r;
 }
 
 /* receiver finalization, called once at the very end.
    you may find that you don't need it, in which case you can leave it blank.
    in certain cases, you might want to use this opportunity to release some 
    memory you allocated in Receiver_init(). */
-void Receiver_Final()
+void Receiver_Final(Simulation *sim)
 {
-    fprintf(stdout, "At %.2fs: receiver finalizing ...\n", GetSimulationTime());
+    RDT_TRACE(sim, "At %.2fs: receiver finalizing ...\n", GetSimulationTime(sim));
+    ReceiverState *r = sim->receiver;
+    free(r->msg_buf);
+    delete r;
+    sim->receiver = NULL;
 }
 
 /* event handler, called when a packet is passed from the lower layer at the 
    receiver */
-void Receiver_FromLowerLayer(struct packet *pkt)
+void Receiver_FromLowerLayer(Simulation *sim, struct packet *pkt)
 {
-    /* 1-byte header indicating the size of the payload */
-    /* 1-byte header indicating the sequence number */
-    /* 2-byte header indicating the checksum */
-    int header_size = 4;
+    ReceiverState *r = sim->receiver;
+    std::vector<int> &slot_size = r->slot_size;
+    std::vector<bool> &flag_buffer = r->flag_buffer;
+    seq_nr_t &next_frame_expected = r->next_frame_expected;
+
+    /* integrity check, payload size and sequence field */
+    int check_width = sim->cfg.check_width;
+    int size_width = sim->cfg.size_width;
+    int header_size = HeaderSize(sim->cfg.seq_width, check_width, size_width, sim->cfg.conn_width);
     ASSERT(pkt);
-    seq_nr_t seq_num = pkt->data[3] & 127;
-    ASSERT(seq_num < 128);
-    bool end_flag = ((pkt->data[3] & 128) != 0);
-
-    fprintf(stdout, "At %.2fs: a packet received(%d),expected(%d), flag:(%d)!\n", GetSimulationTime(), seq_num, next_frame_expected, end_flag);
-    /* sanity check in case the packet is corrupted */
-    if(*((u_int16_t*)pkt->data) != chksum(pkt->data + 2, pkt->data[2] + 2)){
-        fprintf(stdout, "At %.2fs: a packet corrupted!\n", GetSimulationTime());
+    seq_nr_t seq_num = GetSeq(pkt, check_width, size_width, sim->cfg.seq_width);
+    ASSERT(seq_num < r->seq_size);
+    bool end_flag = GetEndFlag(pkt, check_width, size_width);
+
+    RDT_TRACE(sim, "At %.2fs: a packet received(%d),expected(%d), flag:(%d)!\n", GetSimulationTime(sim), seq_num, next_frame_expected, end_flag);
+    /* sanity check in case the packet is corrupted, the size field must
+       agree with the length of the packet */
+    int size = GetSize(pkt, check_width, size_width);
+    if(size == 0 && r->fec_block > 0){
+        /* a parity packet, whose check covers all of it */
+        if(!CheckPassed(pkt, sim->cfg.check_kind, pkt->size)){
+            RDT_TRACE(sim, "At %.2fs: a packet corrupted!\n", GetSimulationTime(sim));
+            RECEIVER_RECORD(sim, TRACE_PKT_CORRUPT, seq_num);
+            return;
+        }
+        RECEIVER_RECORD(sim, TRACE_PARITY_RECV, seq_num);
+        Receiver_FecParity(sim, pkt, seq_num);
+        return;
+    }
+    if(size + header_size != pkt->size
+       || !CheckPassed(pkt, sim->cfg.check_kind, pkt->size)){
+        RDT_TRACE(sim, "At %.2fs: a packet corrupted!\n", GetSimulationTime(sim));
+        RECEIVER_RECORD(sim, TRACE_PKT_CORRUPT, seq_num);
         return;
     }
+    RECEIVER_RECORD(sim, TRACE_PKT_RECV, seq_num);
 
     /* if a previous ack is lost or corrupted*/
     // if(between((next_frame_expected + SEQ_SIZE - WINDOW_SIZE) % SEQ_SIZE, seq_num, next_frame_expected)){
@@ -121,44 +345,66 @@ void Receiver_FromLowerLayer(struct packet *pkt)
     //     acknowledge(next_frame_expected - 1);
     //     return;
     // }
-    if(!between(next_frame_expected, seq_num, (next_frame_expected+WINDOW_SIZE)%SEQ_SIZE)){
+    if(!between(next_frame_expected, seq_num, addNum(next_frame_expected, r->window_size, r->seq_size), r->seq_size)){
         //acknowledge(pkt->data[3]);
-        acknowledge((next_frame_expected + SEQ_SIZE - 1) % SEQ_SIZE);
+        acknowledge(sim, addNum(next_frame_expected, r->seq_size - 1, r->seq_size));
         return;
     }
 
-    /* construct a message and deliver to the upper layer */
-    struct message *msg = (struct message*) malloc(sizeof(struct message));
-    ASSERT(msg!=NULL);
-    msg->size = pkt->data[2];
-    ASSERT(msg->size > 0);
-    msg->data = (char*) malloc(msg->size);
-    ASSERT(msg->data!=NULL);
-    memcpy(msg->data, pkt->data+header_size, msg->size);
+    ASSERT(size > 0);
 
+    bool accepted = true;
     if(seq_num == next_frame_expected){
-        //Receiver_ToUpperLayer(msg);
-        Receiver_SubmitMsg(msg, end_flag);
-        incNum(next_frame_expected, SEQ_SIZE);
-        int counter = 0;
-        while(recv_buffer[next_frame_expected] != NULL && counter < 9){
-            //Receiver_ToUpperLayer(recv_buffer[next_frame_expected]);
-            Receiver_SubmitMsg(recv_buffer[next_frame_expected], flag_buffer[next_frame_expected]);
-            recv_buffer[next_frame_expected] = NULL;
-            flag_buffer[next_frame_expected] = 0;
-            incNum(next_frame_expected, SEQ_SIZE);
-            counter++;
+        /* deliver the packet and the whole run of packets held after it */
+        if(r->fec_block > 0) Receiver_FecAdd(r, seq_num, size, end_flag, pkt->data + header_size);
+        Receiver_SubmitPayload(sim, pkt->data + header_size, size, end_flag);
+        Receiver_Advance(sim);
+        int drained = 0;
+        while(slot_size[r->buffer_head] != 0){
+            Receiver_SubmitPayload(sim, &r->slot_data[(size_t)r->buffer_head * r->slot_payload],
+                                   slot_size[r->buffer_head], flag_buffer[r->buffer_head]);
+            slot_size[r->buffer_head] = 0;
+            flag_buffer[r->buffer_head] = 0;
+            Receiver_Advance(sim);
+            drained++;
         }
-        acknowledge((next_frame_expected + SEQ_SIZE - 1) % SEQ_SIZE);
+
+        /* a packet filling a gap is acked right away, the sender is held up
+           by it.  otherwise the ack may wait for more packets to cover */
+        if(drained > 0 || ++r->unacked >= sim->cfg.ack_every)
+            acknowledge(sim, addNum(next_frame_expected, r->seq_size - 1, r->seq_size));
+        else if(!Receiver_isTimerSet(sim))
+            Receiver_StartTimer(sim, sim->cfg.ack_delay);
     }
     else{
-        if(recv_buffer[seq_num] == NULL){
-            recv_buffer[seq_num] = msg;
-            flag_buffer[seq_num] = end_flag;
+        /* a duplicate leaves the copy held alone */
+        int slot = (r->buffer_head + distance(next_frame_expected, seq_num, r->seq_size)) % r->window_size;
+        if(slot_size[slot] == 0){
+            memcpy(&r->slot_data[(size_t)slot * r->slot_payload], pkt->data + header_size, size);
+            slot_size[slot] = size;
+            flag_buffer[slot] = end_flag;
+            if(r->fec_block > 0) Receiver_FecAdd(r, seq_num, size, end_flag, pkt->data + header_size);
         }else{
-            /* don't forget to free the space */
-            free(msg->data);
-            free(msg);
+            accepted = false;
         }
+        /* let the sender know what is held out of order, or at least that
+           something got past the gap */
+        if(sim->cfg.sack || sim->cfg.fast_retransmit)
+            acknowledge(sim, addNum(next_frame_expected, r->seq_size - 1, r->seq_size));
     }
+
+    /* the packet may complete all but one of its block */
+    if(accepted && r->fec_block > 0)
+        Receiver_FecRecover(sim, seq_num - seq_num % r->fec_block);
+}
+
+/* event handler, called when the timer expires: the delayed ack is due */
+void Receiver_Timeout(Simulation *sim)
+{
+    ReceiverState *r = sim->receiver;
+    RDT_TRACE(sim, "At %.2fs: delayed ack(%d)\n", GetSimulationTime(sim), r->unacked);
+    if(r->unacked == 0) return;
+    RECEIVER_RECORD(sim, TRACE_ACK_DELAYED, addNum(r->next_frame_expected, r->seq_size - 1, r->seq_size));
+    GetStats(sim)->acks_delayed++;
+    acknowledge(sim, addNum(r->next_frame_expected, r->seq_size - 1, r->seq_size));
 }
@@ -10,19 +10,33 @@
 
 #include "rdt_struct.h"
 
+/* the simulation context, every routine below works on behalf of the 
+   simulation passed in as its first argument */
+class Simulation;
+
 
 /*[]------------------------------------------------------------------------[]
   |  routines that you can call
   []------------------------------------------------------------------------[]*/
 
 /* get simulation time (in seconds) */
-double GetSimulationTime();
+double GetSimulationTime(Simulation *sim);
 
 /* pass a packet to the lower layer at the receiver */
-void Receiver_ToLowerLayer(struct packet *pkt);
+void Receiver_ToLowerLayer(Simulation *sim, struct packet *pkt);
 
 /* deliver a message to the upper layer at the receiver */
-void Receiver_ToUpperLayer(struct message *msg);
+void Receiver_ToUpperLayer(Simulation *sim, struct message *msg);
+
+/* start the receiver timer with a specified timeout (in seconds), replacing
+   the one running.  Receiver_Timeout() will be called when it expires */
+void Receiver_StartTimer(Simulation *sim, double timeout);
+
+/* stop the receiver timer */
+void Receiver_StopTimer(Simulation *sim);
+
+/* check whether the receiver timer is being set */
+bool Receiver_isTimerSet(Simulation *sim);
 
 
 /*[]------------------------------------------------------------------------[]
@@ -31,16 +45,19 @@ void Receiver_ToUpperLayer(struct message *msg);
 
 /* receiver initialization, called once at the very beginning.
    this routine is here to help you.  leave it blank if you don't need it.*/
-void Receiver_Init();
+void Receiver_Init(Simulation *sim);
 
 /* receiver finalization, called once at the very end.
    this routine is here to help you.  leave it blank if you don't need it.
    in certain cases, you might want to use this opportunity to release some 
    memory you allocated in Receiver_init(). */
-void Receiver_Final();
+void Receiver_Final(Simulation *sim);
 
 /* event handler, called when a packet is passed from the lower layer at the 
    receiver */
-void Receiver_FromLowerLayer(struct packet *pkt);
+void Receiver_FromLowerLayer(Simulation *sim, struct packet *pkt);
+
+/* event handler, called when the timer expires */
+void Receiver_Timeout(Simulation *sim);
 
 #endif  /* _RDT_RECEIVER_H_ */
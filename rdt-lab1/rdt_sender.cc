@@ -1,210 +1,656 @@
 /*
  * FILE: rdt_sender.cc
  * DESCRIPTION: Reliable data transfer sender.
- * NOTE: This implementation assumes there is no packet loss, corruption, or 
- *       reordering.  You will need to enhance it to deal with all these 
- *       situations.  In this implementation, the packet format is laid out as 
- *       the following:
- *       
- *       |<-  1 byte  ->|<-             the rest            ->|
- *       | payload size |<-             payload             ->|
- *
- *       The first byte of each packet indicates the size of the payload
- *       (excluding this single-byte header)
+ * NOTE: Messages are split into packets queued on a fixed ring and sent over
+ *       a sliding window of sim->cfg.window_size packets at its head, each
+ *       retransmitted on its own timer until a cumulative ack covers it.
+ *       No more packets than the congestion window (rdt_cc.h) are in
+ *       flight at a time.  With forward error correction, a parity packet
+ *       (rdt_fec.h) follows each block of packets sent for the first time.
+ *       With coalescing, small messages share packets: the packet at the
+ *       tail of the ring takes chunks of messages until it is full or its
+ *       flush delay runs out, or nothing is in flight.  The packet header
+ *       is laid out in utils.h.
  */
 
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <list>
+#include <math.h>
+#include <vector>
 #include "rdt_struct.h"
 #include "rdt_sender.h"
+#include "rdt_sim.h"
+#include "rdt_timer.h"
+#include "rdt_cc.h"
+#include "rdt_fec.h"
 #include "utils.h"
 
-struct SenderTimer{
-    packet* pkt;
-    double expire_time;
-    bool acked;
+struct SenderState{
+    /* packets live in a ring of ring_size slots from the upper layer until
+       they are acked: the nbuffered packets in flight start at
+       next_ack_expected, the packets waiting for the window follow them up
+       to nqueued, no more than wait_size of them.  a packet moves into the
+       window where it lies, and every per-slot vector below is indexed by
+       ring slot.  sequence numbers wrap around at seq_size */
+    int window_size;
+    int wait_size;
+    int ring_size;
+    uint64_t seq_size;
+    std::vector<packet> ring;
+    std::vector<char> ring_data;    /* the bytes of the slots, an MTU each */
+
+    /* one virtual timer per window slot, and the expiry the simulator timer
+       is currently set for */
+    SlotTimers timers;
+    double timer_expire;
+
+    /* retransmission timeout estimation (Jacobson/Karels).  the time each
+       slot was last sent and whether it has been resent: by Karn's rule an
+       acknowledged retransmission gives no round trip time sample.  the
+       timeout of a packet is doubled each time it times out, until a
+       cumulative ack moves the head on */
+    std::vector<double> send_time;
+    std::vector<bool> resent;
+    std::vector<int> backoff;
+    bool rtt_measured;
+    double srtt;
+    double rttvar;
+    double rto;
+
+    /* selective acks: whether the receiver holds the packet of a slot, and
+       whether the slot has been resent ahead of its timer since it was sent.
+       and the number of acks in a row repeating the one before the head */
+    std::vector<bool> sacked;
+    std::vector<bool> fast_resent;
+    int dup_acks;
+
+    /* congestion control, and the end of the round trip after a window
+       reduction during which further losses belong to the same episode */
+    CongestionControl *cc;
+    double recover_until;
+
+    /* the XOR of the block being sent, and the packets of it the last
+       parity sent covers */
+    FecBlock fec;
+    int fec_sent;
+
+    /* coalescing: whether the packet at the tail of the ring is still being
+       filled, and when it has to go out */
+    bool tail_open;
+    double flush_at;
+
+    //seq_nr_t next_frame_to_send;
+    seq_nr_t next_ack_expected;
+    seq_nr_t next_seq_num;
+    seq_nr_t nbuffered;
+    seq_nr_t nqueued;
 };
 
-packet sliding_window[WINDOW_SIZE];
-std::list<packet>wait_buffer;
-std::list<SenderTimer>timer_chain;
-
-//seq_nr_t next_frame_to_send = 0;
-seq_nr_t next_ack_expected = 0;
-seq_nr_t next_seq_num = 0;
-seq_nr_t nbuffered = 0;
-
-static seq_nr_t GetSeqNum(packet* pkt){ ASSERT(pkt); return (seq_nr_t)(pkt->data[3] & 127); }
-
-static void Sender_AddTimer(packet* pkt, double expire_time){
-    printf("At %.2fs: Add timer(%d)\n", GetSimulationTime(), GetSeqNum(pkt));
-    SenderTimer timer;
-    timer.acked = false;
-    timer.expire_time = expire_time;
-    timer.pkt = pkt;
-    timer_chain.push_back(timer);
-    if(timer_chain.size() == 1 && !Sender_isTimerSet()){
-        Sender_StartTimer(TIME_OUT);
-    }
-}
-
-static void Sender_RemoveTimer(seq_nr_t seq_num){
-    printf("At %.2fs: Remove timer(%d)\n", GetSimulationTime(), seq_num);
-    ASSERT(timer_chain.size()!=0);
-    ASSERT(Sender_isTimerSet());
-    if(GetSeqNum(timer_chain.front().pkt) == seq_num){
-        Sender_StopTimer();
-        timer_chain.pop_front();
-        while(timer_chain.size()!=0){
-            if(timer_chain.front().acked){
-                timer_chain.pop_front();
-            }else{
-                printf("At %.2fs: Start timer(%d),rest time(%.2fs)\n", GetSimulationTime(),
-                 GetSeqNum(timer_chain.front().pkt), timer_chain.front().expire_time - GetSimulationTime());
-                Sender_StartTimer(timer_chain.front().expire_time - GetSimulationTime());
-                break;
-            }
-        }
+/* record an event of the sender into the trace ring, with the packets in
+   flight and waiting for the window */
+#define SENDER_RECORD(sim, event, seq) \
+    RDT_RECORD(sim, event, seq, (sim)->sender->nbuffered, \
+               (int)((sim)->sender->nqueued - (sim)->sender->nbuffered))
+
+static seq_nr_t GetSeqNum(Simulation *sim, packet* pkt){ ASSERT(pkt); return GetSeq(pkt, sim->cfg.check_width, sim->cfg.size_width, sim->cfg.seq_width); }
+
+static void Sender_AddTimer(Simulation *sim, int slot, double expire_time){
+    SenderState *s = sim->sender;
+    RDT_TRACE(sim, "At %.2fs: Add timer(%d)\n", GetSimulationTime(sim), GetSeqNum(sim, &s->ring[slot]));
+    s->timers.arm(slot, expire_time);
+}
+
+static void Sender_RemoveTimer(Simulation *sim, int slot){
+    SenderState *s = sim->sender;
+    RDT_TRACE(sim, "At %.2fs: Remove timer(%d)\n", GetSimulationTime(sim), GetSeqNum(sim, &s->ring[slot]));
+    ASSERT(s->timers.armed(slot));
+    s->timers.disarm(slot);
+}
+
+/* the timeout a slot is timed with, backed off by its own timeouts */
+static double Sender_SlotRTO(SenderState *s, int slot){
+    double timeout = ldexp(s->rto, s->backoff[slot]);
+    return timeout > RTO_MAX ? RTO_MAX : timeout;
+}
+
+/* record the timeout the oldest packet is timed with */
+static void Sender_RecordRTO(Simulation *sim){
+    SenderState *s = sim->sender;
+    RecordRTO(sim, s->srtt, s->rttvar, Sender_SlotRTO(s, s->next_ack_expected));
+}
+
+/* take a new retransmission timeout, kept within [RTO_MIN, RTO_MAX] */
+static void Sender_SetRTO(Simulation *sim, double rto){
+    SenderState *s = sim->sender;
+    if(rto < RTO_MIN) rto = RTO_MIN;
+    if(rto > RTO_MAX) rto = RTO_MAX;
+    s->rto = rto;
+    Sender_RecordRTO(sim);
+}
+
+/* fold a round trip time sample into the estimate, with a fixed timeout the
+   estimate is kept for the statistics only */
+static void Sender_SampleRTT(Simulation *sim, double rtt){
+    SenderState *s = sim->sender;
+    RDT_TRACE(sim, "At %.2fs: rtt sample(%.3fs)\n", GetSimulationTime(sim), rtt);
+    GetStats(sim)->rtt_samples++;
+    if(!s->rtt_measured){
+        s->srtt = rtt;
+        s->rttvar = rtt / 2;
+        s->rtt_measured = true;
     }else{
-        for(auto& iter:timer_chain){
-            if(GetSeqNum(iter.pkt) == seq_num) iter.acked = true;
+        s->rttvar = 0.75 * s->rttvar + 0.25 * fabs(s->srtt - rtt);
+        s->srtt = 0.875 * s->srtt + 0.125 * rtt;
+    }
+    RecordRTT(sim, s->srtt, s->rttvar);
+    if(sim->cfg.adaptive_rto){
+        double margin = 4 * s->rttvar > RTO_GRANULARITY ? 4 * s->rttvar : RTO_GRANULARITY;
+        Sender_SetRTO(sim, s->srtt + margin);
+    }
+}
+
+/* the packets allowed in flight, the congestion window within the sliding
+   window, at least one */
+static seq_nr_t Sender_Window(SenderState *s){
+    double cwnd = floor(s->cc->cwnd());
+    if(cwnd < 1) cwnd = 1;
+    if(cwnd > s->window_size) cwnd = s->window_size;
+    return (seq_nr_t)cwnd;
+}
+
+/* tell congestion control of a loss, once per round trip */
+static void Sender_Congestion(Simulation *sim, bool timeout){
+    SenderState *s = sim->sender;
+    double now = GetSimulationTime(sim);
+    if(now < s->recover_until) return;
+
+    if(timeout) s->cc->on_timeout(now);
+    else s->cc->on_loss(now);
+    s->recover_until = now + (s->rtt_measured ? s->srtt : s->rto);
+    RDT_TRACE(sim, "At %.2fs: congestion window(%.2f)\n", now, s->cc->cwnd());
+    RecordCwnd(sim, s->cc->cwnd(), s->cc->ssthresh());
+}
+
+/* payload room of a data packet, which leaves room for the parity fields
+   with forward error correction */
+static int Sender_MaxPayload(Simulation *sim){
+    int maxpayload_size = sim->cfg.mtu - HeaderSize(sim->cfg.seq_width, sim->cfg.check_width, sim->cfg.size_width, sim->cfg.conn_width);
+    return sim->cfg.fec_block > 0 ? maxpayload_size - FEC_OVERHEAD : maxpayload_size;
+}
+
+/* send the parity of the first n packets of the current block.  it takes no
+   sequence number and no timer, and is never resent */
+static void Sender_SendParity(Simulation *sim, int n){
+    SenderState *s = sim->sender;
+    int check_width = sim->cfg.check_width;
+    int size_width = sim->cfg.size_width;
+    int header_size = HeaderSize(sim->cfg.seq_width, check_width, size_width, sim->cfg.conn_width);
+    char buf[RDT_PKTSIZE_MAX];
+    packet pkt;
+    pkt.data = buf;
+    memset(buf, 0, header_size);
+    PutSize(&pkt, check_width, size_width, 0);
+    PutSeq(&pkt, check_width, size_width, sim->cfg.seq_width, s->fec.start, false);
+    PutConn(&pkt, check_width, size_width, sim->cfg.seq_width, sim->cfg.conn_width, sim->conn->id);
+    pkt.size = header_size + s->fec.put_parity(&pkt, header_size, n);
+    PutCheck(&pkt, sim->cfg.check_kind, pkt.size);
+
+    RDT_TRACE(sim, "At %.2fs: send parity(%d+%d)!\n", GetSimulationTime(sim), (int)s->fec.start, n);
+    SENDER_RECORD(sim, TRACE_PARITY_SEND, s->fec.start);
+    Sender_ToLowerLayer(sim, &pkt);
+    GetStats(sim)->fec_parity_sent++;
+    s->fec_sent = n;
+}
+
+/* fold a packet sent for the first time into the parity of its block, and
+   send the parity once the block is complete */
+static void Sender_FecAdd(Simulation *sim, packet *pkt){
+    SenderState *s = sim->sender;
+    int k = sim->cfg.fec_block;
+    seq_nr_t seq = GetSeqNum(sim, pkt);
+    int index = seq % k;
+    if(!s->fec.live || s->fec.start != seq - index){
+        s->fec.reset(seq - index, Sender_MaxPayload(sim));
+        s->fec_sent = 0;
+    }
+    int check_width = sim->cfg.check_width;
+    int size_width = sim->cfg.size_width;
+    int header_size = HeaderSize(sim->cfg.seq_width, check_width, size_width, sim->cfg.conn_width);
+    s->fec.add(index, GetSize(pkt, check_width, size_width),
+               GetEndFlag(pkt, check_width, size_width), pkt->data + header_size);
+    if(s->fec.count == k) Sender_SendParity(sim, k);
+}
+
+/* send the packet in a window slot and start its timer */
+static void Sender_SendSlot(Simulation *sim, int slot, bool resend){
+    SenderState *s = sim->sender;
+    Sender_ToLowerLayer(sim, &s->ring[slot]);
+    GetStats(sim)->pkts_sent++;
+    s->send_time[slot] = GetSimulationTime(sim);
+    s->resent[slot] = resend;
+    if(!resend){
+        s->backoff[slot] = 0;
+        s->sacked[slot] = false;
+        s->fast_resent[slot] = false;
+        if(sim->cfg.fec_block > 0) Sender_FecAdd(sim, &s->ring[slot]);
+    }
+
+    Sender_AddTimer(sim, slot, GetSimulationTime(sim) + Sender_SlotRTO(s, slot));
+}
+
+/* resend a packet taken as lost ahead of its timer, once per transmission */
+static void Sender_FastRetransmit(Simulation *sim, int slot){
+    SenderState *s = sim->sender;
+    if(s->fast_resent[slot]) return;
+    RDT_TRACE(sim, "At %.2fs: fast resend packet(%d)!\n", GetSimulationTime(sim), GetSeqNum(sim, &s->ring[slot]));
+    SENDER_RECORD(sim, TRACE_FAST_RESEND, GetSeqNum(sim, &s->ring[slot]));
+    GetStats(sim)->pkts_retransmitted++;
+    GetStats(sim)->pkts_fast_retransmitted++;
+    s->fast_resent[slot] = true;
+    Sender_Congestion(sim, false);
+    Sender_SendSlot(sim, slot, true);
+}
+
+/* mark the packets a selective ack reports as received, then resend each hole
+   with at least DUPACK_THRESH reported packets above it */
+static void Sender_ProcessSack(Simulation *sim, packet *pkt, seq_nr_t ack){
+    SenderState *s = sim->sender;
+    if(s->nbuffered == 0) return;
+
+    const u_int8_t *bitmap = (const u_int8_t*)pkt->data + HeaderSize(sim->cfg.seq_width, sim->cfg.check_width, sim->cfg.size_width, sim->cfg.conn_width);
+    int nbits = 8 * GetSize(pkt, sim->cfg.check_width, sim->cfg.size_width);
+    seq_nr_t head = GetSeqNum(sim, &s->ring[s->next_ack_expected]);
+    int highest = -1;
+    for(int i = 0; i < nbits; i++){
+        if(!(bitmap[i / 8] & (0x80 >> (i % 8)))) continue;
+        /* skip bits outside the window, left over from a stale ack.  the
+           head is what the receiver waits for, it keeps its timer */
+        uint64_t offset = distance(head, addNum(ack, 2 + i, s->seq_size), s->seq_size);
+        if(offset == 0 || offset >= s->nbuffered) continue;
+
+        int slot = (s->next_ack_expected + offset) % s->ring_size;
+        highest = (int)offset;
+        if(s->sacked[slot]) continue;
+        s->sacked[slot] = true;
+        GetStats(sim)->pkts_sacked++;
+        if(s->timers.armed(slot)) Sender_RemoveTimer(sim, slot);
+    }
+
+    int above = 0;
+    for(int offset = highest; offset >= 0; offset--){
+        int slot = (s->next_ack_expected + offset) % s->ring_size;
+        if(s->sacked[slot]){
+            above++;
+        }else if(above >= DUPACK_THRESH){
+            Sender_FastRetransmit(sim, slot);
         }
     }
 }
 
+/* point the simulator timer at the earliest virtual timer, or the flush of
+   the packet being filled */
+static void Sender_RefreshTimer(Simulation *sim){
+    SenderState *s = sim->sender;
+    double expire_time;
+    bool armed = s->timers.earliest(&expire_time);
+    if(s->tail_open && (!armed || s->flush_at < expire_time)){
+        expire_time = s->flush_at;
+        armed = true;
+    }
+    if(!armed){
+        if(Sender_isTimerSet(sim)) Sender_StopTimer(sim);
+        return;
+    }
+    if(Sender_isTimerSet(sim) && expire_time == s->timer_expire) return;
+
+    RDT_TRACE(sim, "At %.2fs: Start timer,rest time(%.2fs)\n", GetSimulationTime(sim),
+              expire_time - GetSimulationTime(sim));
+    double timeout = expire_time - GetSimulationTime(sim);
+    Sender_StartTimer(sim, timeout > 0 ? timeout : 0);
+    s->timer_expire = expire_time;
+}
+
 /* sender initialization, called once at the very beginning */
-void Sender_Init()
+void Sender_Init(Simulation *sim)
 {
-    fprintf(stdout, "At %.2fs: sender initializing ...\n", GetSimulationTime());
+    RDT_TRACE(sim, "At %.2fs: sender initializing ...\n", GetSimulationTime(sim));
+    SenderState *s = new SenderState;
+    s->window_size = sim->cfg.window_size;
+    /* the wait buffer takes at least one message of the largest size the
+       upper layer generates, or that message could never be accepted */
+    int maxpayload_size = Sender_MaxPayload(sim);
+    s->wait_size = (sim->cfg.msg_max + maxpayload_size - 1) / maxpayload_size;
+    if(s->wait_size < sim->cfg.wait_buffer) s->wait_size = sim->cfg.wait_buffer;
+    s->ring_size = s->window_size + s->wait_size;
+    s->seq_size = SeqSize(sim->cfg.seq_width);
+    s->ring.resize(s->ring_size);
+    s->ring_data.resize((size_t)s->ring_size * sim->cfg.mtu);
+    for(int i = 0; i < s->ring_size; i++){
+        s->ring[i].size = 0;
+        s->ring[i].data = &s->ring_data[(size_t)i * sim->cfg.mtu];
+    }
+    s->send_time.assign(s->ring_size, 0);
+    s->resent.assign(s->ring_size, false);
+    s->backoff.assign(s->ring_size, 0);
+    s->sacked.assign(s->ring_size, false);
+    s->fast_resent.assign(s->ring_size, false);
+    s->dup_acks = 0;
+    s->timers.resize(s->ring_size);
+    s->timer_expire = 0;
+    s->rtt_measured = false;
+    s->srtt = 0;
+    s->rttvar = 0;
+    s->rto = 0;
+    s->next_ack_expected = 0;
+    s->next_seq_num = 0;
+    s->nbuffered = 0;
+    s->nqueued = 0;
+    s->cc = CongestionControl_Create(sim->cfg.cc_kind, s->window_size);
+    ASSERT(s->cc!=NULL);
+    s->recover_until = 0;
+    s->fec_sent = 0;
+    s->tail_open = false;
+    s->flush_at = 0;
+    sim->sender = s;
+    Sender_SetRTO(sim, TIME_OUT);
+    RecordCwnd(sim, s->cc->cwnd(), s->cc->ssthresh());
 }
 
 /* sender finalization, called once at the very end.
    you may find that you don't need it, in which case you can leave it blank.
    in certain cases, you might want to take this opportunity to release some 
    memory you allocated in Sender_init(). */
-void Sender_Final()
+void Sender_Final(Simulation *sim)
+{
+    RDT_TRACE(sim, "At %.2fs: sender finalizing ...\n", GetSimulationTime(sim));
+    delete sim->sender->cc;
+    delete sim->sender;
+    sim->sender = NULL;
+}
+
+/* the packets a message of size bytes is split into, at most, a chunk
+   header in each when coalescing */
+static int Sender_Packets(Simulation *sim, int size){
+    int maxpayload_size = Sender_MaxPayload(sim);
+    if(sim->cfg.coalesce) maxpayload_size -= CHUNK_HEADER;
+    return (size + maxpayload_size - 1) / maxpayload_size;
+}
+
+/* seal the packet being filled, it may be sent from now on */
+static void Sender_CloseTail(Simulation *sim){
+    SenderState *s = sim->sender;
+    packet *pkt = &s->ring[(s->next_ack_expected + s->nqueued - 1) % s->ring_size];
+    RDT_TRACE(sim, "At %.2fs: packet(%d) filled to %d bytes\n", GetSimulationTime(sim), GetSeqNum(sim, pkt), pkt->size);
+    PutCheck(pkt, sim->cfg.check_kind, pkt->size);
+    s->tail_open = false;
+}
+
+/* pack a message into chunks, topping up the packet being filled first */
+static void Sender_Pack(Simulation *sim, struct message *msg){
+    SenderState *s = sim->sender;
+    int check_width = sim->cfg.check_width;
+    int size_width = sim->cfg.size_width;
+    int header_size = HeaderSize(sim->cfg.seq_width, check_width, size_width, sim->cfg.conn_width);
+    int maxpayload_size = Sender_MaxPayload(sim);
+
+    int cursor = 0;
+    while(cursor < msg->size){
+        packet *pkt;
+        if(!s->tail_open){
+            int slot = (s->next_ack_expected + s->nqueued) % s->ring_size;
+            pkt = &s->ring[slot];
+            pkt->size = header_size;
+            memset(pkt->data, 0, header_size);
+            PutSeq(pkt, check_width, size_width, sim->cfg.seq_width, s->next_seq_num, false);
+            PutConn(pkt, check_width, size_width, sim->cfg.seq_width, sim->cfg.conn_width, sim->conn->id);
+            incNum(s->next_seq_num, s->seq_size);
+            RDT_TRACE(sim, "At %.2fs: Enter into ring(%d)\n", GetSimulationTime(sim), GetSeqNum(sim, pkt));
+            s->nqueued++;
+            SENDER_RECORD(sim, TRACE_ENQUEUE, GetSeqNum(sim, pkt));
+            s->tail_open = true;
+            s->flush_at = GetSimulationTime(sim) + sim->cfg.coalesce_delay;
+            GetStats(sim)->pkts_built++;
+        }else{
+            pkt = &s->ring[(s->next_ack_expected + s->nqueued - 1) % s->ring_size];
+        }
+
+        int room = maxpayload_size - (pkt->size - header_size) - CHUNK_HEADER;
+        int len = room < msg->size - cursor ? room : msg->size - cursor;
+        PutChunkHeader(pkt->data + pkt->size, len, cursor + len == msg->size);
+        memcpy(pkt->data + pkt->size + CHUNK_HEADER, msg->data + cursor, len);
+        pkt->size += CHUNK_HEADER + len;
+        PutSize(pkt, check_width, size_width, pkt->size - header_size);
+        cursor += len;
+
+        /* no room left for another chunk */
+        if(pkt->size - header_size + CHUNK_HEADER >= maxpayload_size) Sender_CloseTail(sim);
+    }
+}
+
+/* send the packets waiting at the front of the ring, as far as the window
+   lets them in.  when none are left waiting, the parity of a block cut
+   short goes out too, rather than wait for packets that may never come */
+static void Sender_Drain(Simulation *sim){
+    SenderState *s = sim->sender;
+
+    /* the packet being filled waits for more, unless the link is idle */
+    if(s->tail_open && s->nbuffered == 0) Sender_CloseTail(sim);
+    seq_nr_t ready = s->tail_open ? s->nqueued - 1 : s->nqueued;
+
+    while(s->nbuffered < Sender_Window(s) && s->nbuffered < ready){
+        int next_send = (s->next_ack_expected + s->nbuffered) % s->ring_size;
+        RDT_TRACE(sim, "At %.2fs: send packet(%d)!\n", GetSimulationTime(sim), GetSeqNum(sim, &s->ring[next_send]));
+        SENDER_RECORD(sim, TRACE_SEND, GetSeqNum(sim, &s->ring[next_send]));
+        Sender_SendSlot(sim, next_send, false);
+        s->nbuffered++;
+    }
+    if(sim->cfg.fec_block > 0 && s->nbuffered == s->nqueued
+       && s->fec.live && s->fec.count > s->fec_sent)
+        Sender_SendParity(sim, s->fec.count);
+}
+
+/* whether there is room for a message of size bytes, the upper layer holds
+   or drops the message otherwise */
+bool Sender_Writable(Simulation *sim, int size)
 {
-    fprintf(stdout, "At %.2fs: sender finalizing ...\n", GetSimulationTime());
+    SenderState *s = sim->sender;
+    seq_nr_t npackets = Sender_Packets(sim, size);
+    return s->nqueued - s->nbuffered + npackets <= (seq_nr_t)s->wait_size
+        && s->nqueued + npackets <= (seq_nr_t)s->ring_size;
+}
+
+/* the packets waiting for room in the window */
+int Sender_Waiting(Simulation *sim)
+{
+    SenderState *s = sim->sender;
+    return (int)(s->nqueued - s->nbuffered);
 }
 
 /* event handler, called when a message is passed from the upper layer at the 
    sender */
-void Sender_FromUpperLayer(struct message *msg)
+void Sender_FromUpperLayer(Simulation *sim, struct message *msg)
 {
-    /* 1-byte header indicating the size of the payload */
-    /* 1-byte header indicating the sequence number */
-    /* 2-byte header indicating the checksum */
-    int header_size = 4;
+    SenderState *s = sim->sender;
+
+    /* integrity check, payload size and sequence field */
+    int check_width = sim->cfg.check_width;
+    int size_width = sim->cfg.size_width;
+    int header_size = HeaderSize(sim->cfg.seq_width, check_width, size_width, sim->cfg.conn_width);
 
     /* maximum payload size */
-    int maxpayload_size = RDT_PKTSIZE - header_size;
+    int maxpayload_size = Sender_MaxPayload(sim);
 
-    /* split the message if it is too big */
+    ASSERT(msg);
+    ASSERT(Sender_Writable(sim, msg->size));
+    GetStats(sim)->msgs_accepted++;
 
-    /* reuse the same packet data structure */
-    packet pkt;
+    /* split the message if it is too big, each packet is built in the ring
+       slot it is sent from */
 
     /* the cursor always points to the first unsent byte in the message */
     int cursor = 0;
-    ASSERT(msg);
+    if(sim->cfg.coalesce){
+        Sender_Pack(sim, msg);
+        cursor = msg->size;
+    }
     while (cursor < msg->size) {
-        /* fill in the packet */
-        int payload_size = (maxpayload_size < (msg->size - cursor)) ? maxpayload_size : (msg->size - cursor);
+        int slot = (s->next_ack_expected + s->nqueued) % s->ring_size;
+        packet *pkt = &s->ring[slot];
 
-        pkt.data[2] = payload_size;
-        pkt.data[3] = next_seq_num;
+        /* fill in the packet, as long as its payload */
+        int payload_size = (maxpayload_size < (msg->size - cursor)) ? maxpayload_size : (msg->size - cursor);
+        pkt->size = header_size + payload_size;
+        memset(pkt->data, 0, header_size);
+        PutSize(pkt, check_width, size_width, payload_size);
 
-        /* If it reaches the end of a message, set the first bit*/
-        if(payload_size == (msg->size - cursor)){
-            pkt.data[3] |= (1 << 7);
-        }
+        /* If it reaches the end of a message, set the end flag */
+        PutSeq(pkt, check_width, size_width, sim->cfg.seq_width, s->next_seq_num, payload_size == (msg->size - cursor));
+        PutConn(pkt, check_width, size_width, sim->cfg.seq_width, sim->cfg.conn_width, sim->conn->id);
 
-        incNum(next_seq_num, SEQ_SIZE);
-        memcpy(pkt.data+header_size, msg->data+cursor, payload_size);
+        incNum(s->next_seq_num, s->seq_size);
+        memcpy(pkt->data+header_size, msg->data+cursor, payload_size);
         /* calculate checksum */
-        *((u_int16_t*)pkt.data) = chksum(pkt.data + 2, payload_size + 2);
-
-        /* If there are blank slots, send the packet */
-        if(nbuffered < WINDOW_SIZE && wait_buffer.size() == 0){
-            /* send it out through the lower layer */
-            int next_send = (next_ack_expected + nbuffered) % WINDOW_SIZE;
-            sliding_window[next_send] = pkt;
-            Sender_ToLowerLayer(&sliding_window[next_send]);
-            fprintf(stdout, "At %.2fs: send packet(%d)!\n", GetSimulationTime(), GetSeqNum(&pkt));
-            Sender_AddTimer(&sliding_window[next_send], GetSimulationTime() + TIME_OUT);
-            nbuffered++;
-        }else{
-            /* store the packet in wait buffer */
-            printf("At %.2fs: Enter into wait buffer(%d)\n", GetSimulationTime(), GetSeqNum(&pkt));
-            wait_buffer.emplace_back(pkt);
-        }
+        PutCheck(pkt, sim->cfg.check_kind, payload_size + header_size);
+
+        RDT_TRACE(sim, "At %.2fs: Enter into ring(%d)\n", GetSimulationTime(sim), GetSeqNum(sim, pkt));
+        s->nqueued++;
+        SENDER_RECORD(sim, TRACE_ENQUEUE, GetSeqNum(sim, pkt));
+        GetStats(sim)->pkts_built++;
+
         /* move the cursor */
         cursor += payload_size;
     }
+
+    struct rdt_stats *stats = GetStats(sim);
+    if((int)(s->nqueued - s->nbuffered) > stats->wait_high)
+        stats->wait_high = s->nqueued - s->nbuffered;
+
+    /* If there are blank slots in the window, send the packets */
+    Sender_Drain(sim);
+    Sender_RefreshTimer(sim);
 }
 
 /* event handler, called when a packet is passed from the lower layer at the 
    sender */
-void Sender_FromLowerLayer(struct packet *pkt)
+void Sender_FromLowerLayer(Simulation *sim, struct packet *pkt)
 {
+    SenderState *s = sim->sender;
     ASSERT(pkt);
-    fprintf(stdout, "At %.2fs: a ack(%d) received,expected(%d),nbuffer(%d), waitbuffer(%d)!\n", GetSimulationTime(), 
-            GetSeqNum(pkt), GetSeqNum(&sliding_window[next_ack_expected]), nbuffered, (int)wait_buffer.size());
-    /* sanity check in case the packet is corrupted */
-    if(*((u_int16_t*)pkt->data) != chksum(pkt->data + 2, pkt->data[2] + 2)){
-        fprintf(stdout, "At %.2fs: a packet corrupted!\n", GetSimulationTime());
+    RDT_TRACE(sim, "At %.2fs: a ack(%d) received,expected(%d),nbuffer(%d), waitbuffer(%d)!\n", GetSimulationTime(sim), 
+            GetSeqNum(sim, pkt), GetSeqNum(sim, &s->ring[s->next_ack_expected]), s->nbuffered, (int)(s->nqueued - s->nbuffered));
+    /* sanity check in case the packet is corrupted, the size field must
+       agree with the length of the packet */
+    int header_size = HeaderSize(sim->cfg.seq_width, sim->cfg.check_width, sim->cfg.size_width, sim->cfg.conn_width);
+    int size = GetSize(pkt, sim->cfg.check_width, sim->cfg.size_width);
+    if(size + header_size != pkt->size
+       || !CheckPassed(pkt, sim->cfg.check_kind, pkt->size)){
+        RDT_TRACE(sim, "At %.2fs: a packet corrupted!\n", GetSimulationTime(sim));
+        SENDER_RECORD(sim, TRACE_ACK_CORRUPT, GetSeqNum(sim, pkt));
         return;
     }
 
-    seq_nr_t ack = GetSeqNum(pkt);
-    while(nbuffered > 0 && between(GetSeqNum(&sliding_window[next_ack_expected]), ack,
-             (GetSeqNum(&sliding_window[(next_ack_expected+nbuffered+WINDOW_SIZE-1)%WINDOW_SIZE])+1)%SEQ_SIZE)){
-        nbuffered--;
-        Sender_RemoveTimer(GetSeqNum(&sliding_window[next_ack_expected]));
-        incNum(next_ack_expected, WINDOW_SIZE);
+    seq_nr_t ack = GetSeqNum(sim, pkt);
+    SENDER_RECORD(sim, TRACE_ACK_RECV, ack);
+    int last_acked = -1;
+    int last_sent_once = -1;
+    double last_resend = -1;
+    int nacked = 0;
+    while(s->nbuffered > 0 && between(GetSeqNum(sim, &s->ring[s->next_ack_expected]), ack,
+             addNum(GetSeqNum(sim, &s->ring[(s->next_ack_expected+s->nbuffered-1)%s->ring_size]), 1, s->seq_size), s->seq_size)){
+        s->nbuffered--;
+        s->nqueued--;
+        /* packets already selectively acked have no timer left */
+        if(s->timers.armed(s->next_ack_expected)) Sender_RemoveTimer(sim, s->next_ack_expected);
+        last_acked = s->next_ack_expected;
+        nacked++;
+        if(!s->resent[last_acked]) last_sent_once = last_acked;
+        else if(s->send_time[last_acked] > last_resend) last_resend = s->send_time[last_acked];
+        incNum(s->next_ack_expected, s->ring_size);
     }
-    
-    while(nbuffered < WINDOW_SIZE && wait_buffer.size() != 0){
-        int next_send = (next_ack_expected + nbuffered) % WINDOW_SIZE;
-        sliding_window[next_send] = wait_buffer.front();
-        wait_buffer.pop_front();
-        printf("Drain a packet from wait buffer(%d)\n", GetSeqNum(&sliding_window[next_send]));
-        Sender_ToLowerLayer(&sliding_window[next_send]);
-        fprintf(stdout, "At %.2fs: send packet(%d)!\n", GetSimulationTime(), GetSeqNum(&sliding_window[next_send]));
-        Sender_AddTimer(&sliding_window[next_send], GetSimulationTime() + TIME_OUT);
-        nbuffered++;
+    /* the head moved on, the packets still in flight are backed off no
+       more and those that were are timed afresh.  the newest packet acked that was never resent
+       times the round trip, if it went out after the last resend among
+       them, which may otherwise be what held the ack back; by Karn's rule a
+       resent one gives no sample */
+    if(last_acked >= 0){
+        bool backed_off = false;
+        for(seq_nr_t i = 0; i < s->nbuffered; i++){
+            int slot = (s->next_ack_expected + i) % s->ring_size;
+            if(s->backoff[slot] == 0) continue;
+            backed_off = true;
+            s->backoff[slot] = 0;
+            if(s->timers.armed(slot)){
+                Sender_RemoveTimer(sim, slot);
+                Sender_AddTimer(sim, slot, GetSimulationTime(sim) + s->rto);
+            }
+        }
+        if(last_sent_once >= 0 && s->send_time[last_sent_once] > last_resend)
+            Sender_SampleRTT(sim, GetSimulationTime(sim) - s->send_time[last_sent_once]);
+        else if(backed_off)
+            Sender_RecordRTO(sim);
+    }
+
+    if(nacked > 0){
+        double cwnd = s->cc->cwnd();
+        s->cc->on_ack(nacked, GetSimulationTime(sim), s->rtt_measured ? s->srtt : s->rto);
+        if(s->cc->cwnd() != cwnd) RecordCwnd(sim, s->cc->cwnd(), s->cc->ssthresh());
+    }
+
+    /* the receiver still waits for the new head, whatever an earlier sack
+       said: time it again */
+    if(s->nbuffered > 0 && s->sacked[s->next_ack_expected]){
+        s->sacked[s->next_ack_expected] = false;
+        if(!s->timers.armed(s->next_ack_expected))
+            Sender_AddTimer(sim, s->next_ack_expected, GetSimulationTime(sim) + Sender_SlotRTO(s, s->next_ack_expected));
+    }
+
+    /* an ack repeating the one before the head tells of a later packet that
+       got through while the head did not */
+    if(last_acked >= 0){
+        s->dup_acks = 0;
+    }else if(s->nbuffered > 0 && addNum(ack, 1, s->seq_size) == GetSeqNum(sim, &s->ring[s->next_ack_expected])){
+        GetStats(sim)->dup_acks++;
+        if(++s->dup_acks == DUPACK_THRESH && sim->cfg.fast_retransmit)
+            Sender_FastRetransmit(sim, s->next_ack_expected);
     }
+
+    if(sim->cfg.sack) Sender_ProcessSack(sim, pkt, ack);
+    
+    Sender_Drain(sim);
+    Sender_RefreshTimer(sim);
 }
 
 /* event handler, called when the timer expires */
-void Sender_Timeout()
+void Sender_Timeout(Simulation *sim)
 {
-    fprintf(stdout, "At %.2fs: a timeout occurs!\n", GetSimulationTime());
-    packet* pkt = timer_chain.front().pkt;
-    timer_chain.pop_front();
-    fprintf(stdout, "At %.2fs: resend packet(%d)!\n", GetSimulationTime(), GetSeqNum(pkt));
-    Sender_ToLowerLayer(pkt);
-    Sender_AddTimer(pkt, GetSimulationTime() + TIME_OUT);
-    while(timer_chain.size()!=0){
-        if(timer_chain.front().acked){
-            timer_chain.pop_front();
-        }else{
-            printf("At %.2fs: Start timer(%d),rest time(%.2fs)\n", GetSimulationTime(),
-                GetSeqNum(timer_chain.front().pkt), timer_chain.front().expire_time - GetSimulationTime());
-            double new_timeout = timer_chain.front().expire_time - GetSimulationTime();
-            if(new_timeout < 0){
-                pkt = timer_chain.front().pkt;
-                timer_chain.pop_front();
-                fprintf(stdout, "At %.2fs: resend packet(%d)!\n", GetSimulationTime(), GetSeqNum(pkt));
-                Sender_ToLowerLayer(pkt);
-                Sender_AddTimer(pkt, GetSimulationTime() + TIME_OUT);
-            }else{
-                Sender_StartTimer(new_timeout);
-                break;
-            }
+    SenderState *s = sim->sender;
+    RDT_TRACE(sim, "At %.2fs: a timeout occurs!\n", GetSimulationTime(sim));
+    SENDER_RECORD(sim, TRACE_TIMEOUT, addNum(s->next_seq_num, s->seq_size - s->nqueued, s->seq_size));
+
+    /* resend every packet whose virtual timer has expired */
+    int slot;
+    while((slot = s->timers.pop_expired(GetSimulationTime(sim))) >= 0){
+        /* exponential backoff */
+        if(sim->cfg.adaptive_rto && Sender_SlotRTO(s, slot) < RTO_MAX){
+            s->backoff[slot]++;
+            GetStats(sim)->rto_backoffs++;
+            if(slot == (int)s->next_ack_expected) Sender_RecordRTO(sim);
         }
+        RDT_TRACE(sim, "At %.2fs: resend packet(%d)!\n", GetSimulationTime(sim), GetSeqNum(sim, &s->ring[slot]));
+        SENDER_RECORD(sim, TRACE_RESEND, GetSeqNum(sim, &s->ring[slot]));
+        GetStats(sim)->pkts_retransmitted++;
+        GetStats(sim)->pkts_timeout_retransmitted++;
+        Sender_Congestion(sim, true);
+        Sender_SendSlot(sim, slot, true);
+    }
+
+    /* the packet being filled has waited long enough */
+    if(s->tail_open && s->flush_at <= GetSimulationTime(sim) + SlotTimers::EPSILON){
+        GetStats(sim)->coalesce_flushes++;
+        Sender_CloseTail(sim);
+        Sender_Drain(sim);
     }
+    Sender_RefreshTimer(sim);
 }
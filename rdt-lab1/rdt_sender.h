@@ -10,29 +10,33 @@
 
 #include "rdt_struct.h"
 
+/* the simulation context, every routine below works on behalf of the 
+   simulation passed in as its first argument */
+class Simulation;
+
 
 /*[]------------------------------------------------------------------------[]
   |  routines that you can call
   []------------------------------------------------------------------------[]*/
 
 /* get simulation time (in seconds) */
-double GetSimulationTime();
+double GetSimulationTime(Simulation *sim);
 
 /* start the sender timer with a specified timeout (in seconds).
    the timer is canceled with Sender_StopTimer() is called or a new 
    Sender_StartTimer() is called before the current timer expires.
    Sender_Timeout() will be called when the timer expires. */
-void Sender_StartTimer(double timeout);
+void Sender_StartTimer(Simulation *sim, double timeout);
 
 /* stop the sender timer */
-void Sender_StopTimer();
+void Sender_StopTimer(Simulation *sim);
 
 /* check whether the sender timer is being set,
    return true if the timer is set, return false otherwise */
-bool Sender_isTimerSet();
+bool Sender_isTimerSet(Simulation *sim);
 
 /* pass a packet to the lower layer at the sender */
-void Sender_ToLowerLayer(struct packet *pkt);
+void Sender_ToLowerLayer(Simulation *sim, struct packet *pkt);
 
 
 /*[]------------------------------------------------------------------------[]
@@ -41,24 +45,31 @@ void Sender_ToLowerLayer(struct packet *pkt);
 
 /* sender initialization, called once at the very beginning.
    this routine is here to help you.  leave it blank if you don't need it.*/
-void Sender_Init();
+void Sender_Init(Simulation *sim);
 
 /* sender finalization, called once at the very end.
    this routine is here to help you.  leave it blank if you don't need it.
    in certain cases, you might want to take this opportunity to release some 
    memory you allocated in Sender_init(). */
-void Sender_Final();
+void Sender_Final(Simulation *sim);
+
+/* check whether the sender has room for a message of size bytes, the upper
+   layer only passes a message down when it has */
+bool Sender_Writable(Simulation *sim, int size);
+
+/* the packets waiting at the sender for room in the window */
+int Sender_Waiting(Simulation *sim);
 
 /* event handler, called when a message is passed from the upper layer at the 
    sender */
-void Sender_FromUpperLayer(struct message *msg);
+void Sender_FromUpperLayer(Simulation *sim, struct message *msg);
 
 /* event handler, called when a packet is passed from the lower layer at the 
    sender */
-void Sender_FromLowerLayer(struct packet *pkt);
+void Sender_FromLowerLayer(Simulation *sim, struct packet *pkt);
 
 /* event handler, called when the timer expires */
-void Sender_Timeout();
+void Sender_Timeout(Simulation *sim);
 
 
 #endif  /* _RDT_SENDER_H_ */
@@ -17,201 +17,102 @@
 #include "rdt_struct.h"
 #include "rdt_sender.h"
 #include "rdt_receiver.h"
+#include "rdt_sim.h"
+#include "rdt_batch.h"
+#include "rdt_cc.h"
+#include "rdt_fec.h"
+#include "rdt_link.h"
+#include "rdt_workload.h"
+#include "utils.h"
 
 
 /*[]------------------------------------------------------------------------[]
-  |  generic event chain framework
+  |  command line options
   []------------------------------------------------------------------------[]*/
 
-/* simulation event base class */
-class Event
-{
-public:
-    double sched_time;      /* scheduled occuring time */
-    int event_type;         /* application-specific event type */
-    class Event *next;      /* next event in the chain */
+/* everything below main() is compiled out by -DRDT_NO_MAIN, for programs
+   that drive simulations of their own */
+#ifndef RDT_NO_MAIN
 
-public:
-    Event() { next = NULL; }
-};
+/* parameters of the simulation, filled in from the command line */
+static struct sim_config config;
 
-/* event chain class - the simulation core */
-class EventChain
-{
-public:
-    double sim_time;        /* simulation time */
-    Event *head;            /* head event in the chain */
+/* batch mode: the sweep spec, the number of simulations run at a time, 
+   whether they run on threads or in child processes, and the output format
+   of the result rows */
+static const char *batch_spec = NULL;
+static int batch_jobs = 0;
+static const char *batch_workers = "thread";
+static const char *batch_format = "csv";
 
-public:
-    EventChain() {
-	sim_time = 0;
-	head = NULL;
-    }
-    
-    double time() { return sim_time; }
-    
-    /* schedule an event - the event chain is maintained on an increasing order 
-       of sched_time */
-    void schedule(Event *e) {
-	/* do nothing if the event is schedule for the past */
-	if (e->sched_time<sim_time) return;
+/* skip waiting for <enter> before the simulation starts */
+static bool no_prompt = false;
 
-	Event **ppcur = &head;
-	while ((*ppcur!=NULL) && ((*ppcur)->sched_time<=e->sched_time))
-	    ppcur = &((*ppcur)->next);
+/* whether --seed was given, batch runs are seeded from 1 otherwise */
+static bool seed_set = false;
 
-	e->next = *ppcur;
-	*ppcur = e;
-    }
+/* the least width of the sequence field (in bytes), widened as the window
+   requires */
+static int seq_width_min = 1;
 
-    /* cancel an event scheduled for happening in the future */
-    void cancel(Event *e) {
-	Event **ppcur = &head;
-	while ((*ppcur!=NULL) && (*ppcur!=e))
-	    ppcur = &((*ppcur)->next);
+/* whether --wait-buffer was given, if not the default wait buffer is shared
+   among the connections */
+static bool wait_buffer_set = false;
 
-	if (*ppcur==e) *ppcur=(*ppcur)->next;
-    }
-
-    /* advance to the next event */
-    Event *next_event() {
-	if (head==NULL) return NULL;
+/* where to log the RTO and congestion window trajectories of the sender,
+   not logged if NULL */
+static const char *rto_log_path = NULL;
+static const char *cwnd_log_path = NULL;
 
-	Event *e = head;
-	head = head->next;
-	sim_time = e->sched_time;
+/* where to write the time series of the run and the buckets of the
+   message latency histogram, not written if NULL */
+static const char *series_path = NULL;
+static double series_interval = 1.0;
+static const char *latency_log_path = NULL;
 
-	return e;
-    }
-};
+/* where to write the goodput of each connection, not written if NULL */
+static const char *flow_log_path = NULL;
 
+/* where to write the binary event trace of the rdt layers, not traced if
+   NULL, and the events the trace ring keeps, the last of the run */
+static const char *trace_path = NULL;
+static int trace_ring_size = 1<<20;
 
-/*[]------------------------------------------------------------------------[]
-  |  event definitions
-  []------------------------------------------------------------------------[]*/
-
-enum {EVENT_SENDER_FROMUPPERLAYER=0, EVENT_SENDER_FROMLOWERLAYER, 
-      EVENT_SENDER_TIMEOUT, EVENT_RECEIVER_FROMLOWERLAYER};
-
-/* the event that the upper layer at the sender instructs rdt layer to send out 
-   a message */
-class EventSenderFromUpperLayer : public Event
-{
-public:
-    EventSenderFromUpperLayer() { event_type = EVENT_SENDER_FROMUPPERLAYER; }
-};
-
-/* the event that the lower layer at the sender informs the rdt layer that a 
-   packet is received from the link */
-class EventSenderFromLowerLayer : public Event
-{
-public:
-    struct packet pkt;
-public:
-    EventSenderFromLowerLayer() { event_type = EVENT_SENDER_FROMLOWERLAYER; }
-};
-
-/* the event that the timer at the sender expires */
-class EventSenderTimeout : public Event
-{
-public:
-    EventSenderTimeout() { event_type = EVENT_SENDER_TIMEOUT; }
-};
-
-/* the event that the lower layer at the receiver informs the rdt layer that a 
-   packet is received from the link */
-class EventReceiverFromLowerLayer : public Event
-{
-public:
-    struct packet pkt;
-public:
-    EventReceiverFromLowerLayer() { event_type = EVENT_RECEIVER_FROMLOWERLAYER; }
-};
-
-
-/*[]------------------------------------------------------------------------[]
-  |  gloabal variables, statistics, etc.
-  []------------------------------------------------------------------------[]*/
-
-/* total simulation time, the simulation will end at this time (in seconds) */
-double sim_time;
-
-/* average intervals between consecutive messages passed from the upper layer 
-   at the sender (in seconds) */
-double msg_arrivalint;
-
-/* average size of messages (in bytes) */
-int msg_size;
-
-/* average one-way packet delivery latency, set to be 100ms */
-const double pkt_latency = 0.1;
-
-/* the probability that a packet is not delivered with the normal latency:
-   a value of 0.1 means that one in ten packets are not delivered with the 
-   normal latency */
-double outoforder_rate;
-
-/* packet loss probability: a value of 0.1 means that one in ten packets are
-   lost on average */
-double loss_rate;
-
-/* packet corruption probability: a value of 0.1 means that one in ten packets
-   (excluding those lost) are corrupted on average.  note that any part of the 
-   packet can be corrupted */
-double corrupt_rate;
-
-/* tracing levels (higher level always prints out more information):
-   a tracing level of 0 turns off all traces while a tracing, 
-   a tracing level of 1 turns on regular traces,
-   a tracing level of 2 prints out the delivered message
-*/
-int tracing_level;
-
-/* simulation event chain core */
-EventChain sim_core;
-
-/* sender timer event */
-Event *sender_timer = NULL;
-
-/* general statistics */
-int tot_chars_sent = 0;
-int tot_chars_delivered = 0;
-int tot_pkts_passed = 0;
-
-/* error flag set by message verification at the receiver */
-bool message_verfication_passed = true;
+#endif  /* RDT_NO_MAIN */
 
 
 /*[]------------------------------------------------------------------------[]
   |  simulation routines
   []------------------------------------------------------------------------[]*/
 
-/* generate a random number in [0,1] */
-static double myrandom()
+/* generate a random number in [0,1) */
+static double myrandom(Simulation *sim)
 {
-    return(rand()*1.0/RAND_MAX);
+    return sim->rng.uniform();
 }
 
-/* generate a message 
+/* generate a message, as large as the workload has it
    NOTE: change this part if you want to generate different messages for 
-         testing.  we will certainly use different messages in our grading! */
-static struct message *generate_msg()
+	 testing.  we will certainly use different messages in our grading! */
+static struct message *generate_msg(Simulation *sim)
 {
-    static char cnt = 0;
-
     struct message *msg = (struct message*) malloc(sizeof(struct message));
     ASSERT(msg!=NULL);
-    msg->size = (int)(myrandom()*2.0*msg_size);
-    if (msg->size==0) msg->size=1;
+    Connection *c = sim->conn;
+    msg->size = c->workload->size(&sim->rng);
+    ASSERT(msg->size>0 && msg->size<=sim->cfg.msg_max);
     msg->data = (char*) malloc(msg->size);
     ASSERT(msg->data!=NULL);
 
     for (int i=0; i<msg->size; i+=1) {
-	msg->data[i] = '0' + cnt;
-	cnt = (cnt+1) % 10;
+	msg->data[i] = '0' + c->generate_cnt;
+	c->generate_cnt = (c->generate_cnt+1) % 10;
     }
 
-    tot_chars_sent += msg->size;
+    sim->tot_chars_sent += msg->size;
+    c->chars_sent += msg->size;
+    Connection::msg_stamp stamp = {sim->sim_core.time(), msg->size};
+    c->msg_stamps.push_back(stamp);
     //tot_chars_sent ++;
     return msg;
 }
@@ -223,129 +124,301 @@ static void free_msg(struct message *msg)
     if (msg!=NULL) free(msg);
 }
 
+/* take back a message the upper layer drops instead of passing it down, as
+   if it had never been generated */
+static void drop_msg(Simulation *sim, struct message *msg)
+{
+    Connection *c = sim->conn;
+    sim->tot_chars_sent -= msg->size;
+    c->chars_sent -= msg->size;
+    c->generate_cnt = (c->generate_cnt + 10 - msg->size % 10) % 10;
+    sim->tot_msgs_dropped++;
+    sim->tot_chars_dropped += msg->size;
+    c->msg_stamps.pop_back();
+    free_msg(msg);
+}
+
+/* schedule the next message arrival, until the simulation time is up or
+   the workload has no more */
+static void schedule_arrival(Simulation *sim, EventSenderFromUpperLayer *e)
+{
+    double gap;
+    if (sim->sim_core.time() < sim->cfg.sim_time
+	&& (gap = sim->conn->workload->gap(&sim->rng))>=0) {
+	e->sched_time = sim->sim_core.time() + gap;
+	sim->sim_core.schedule(e);
+    }
+    else
+	sim->upper_event_pool.release(e);
+}
+
+/* get the statistics of the running simulation */
+struct rdt_stats *GetStats(Simulation *sim)
+{
+    return &sim->stats;
+}
+
+/* record a new retransmission timeout of the sender of the current
+   connection */
+void RecordRTO(Simulation *sim, double srtt, double rttvar, double rto)
+{
+    struct rdt_stats *stats = &sim->stats;
+    struct rdt_flow_stats *flow = &sim->conn->flow;
+    if (stats->rto_updates==0 || rto<stats->rto_min) stats->rto_min = rto;
+    if (stats->rto_updates==0 || rto>stats->rto_max) stats->rto_max = rto;
+    stats->rto_updates++;
+    stats->rto_sum += rto;
+    flow->rto_updates++;
+    flow->srtt = srtt;
+    flow->rttvar = rttvar;
+    flow->rto = rto;
+
+    if (sim->rto_log!=NULL)
+	fprintf(sim->rto_log, "%.6f,%d,%.6f,%.6f,%.6f\n", 
+		sim->sim_core.time(), sim->conn->id, srtt, rttvar, rto);
+}
+
+/* record a new round trip time estimate of the sender of the current
+   connection */
+void RecordRTT(Simulation *sim, double srtt, double rttvar)
+{
+    sim->conn->flow.srtt = srtt;
+    sim->conn->flow.rttvar = rttvar;
+}
+
+/* record a new congestion window of the sender of the current connection.
+   a window is reduced only against the last one of the same sender */
+void RecordCwnd(Simulation *sim, double cwnd, double ssthresh)
+{
+    struct rdt_stats *stats = &sim->stats;
+    struct rdt_flow_stats *flow = &sim->conn->flow;
+    double now = sim->sim_core.time();
+    if (flow->cwnd_updates>0) {
+	flow->cwnd_area += flow->cwnd*(now-flow->cwnd_time);
+	if (cwnd<flow->cwnd) stats->cwnd_reductions++;
+    }
+    if (stats->cwnd_updates==0 || cwnd>stats->cwnd_max) stats->cwnd_max = cwnd;
+    stats->cwnd_updates++;
+    flow->cwnd_updates++;
+    flow->cwnd_time = now;
+    flow->cwnd = cwnd;
+    flow->ssthresh = ssthresh;
+
+    if (sim->cwnd_log!=NULL)
+	fprintf(sim->cwnd_log, "%.6f,%d,%.3f,%.3f\n", now, sim->conn->id,
+		cwnd, ssthresh);
+}
+
 /* get simulation time (in seconds) - for both the sender and the receiver */
-double GetSimulationTime()
+double GetSimulationTime(Simulation *sim)
 {
-    return sim_core.time();
+    return sim->sim_core.time();
 }
 
 /* start the sender timer with a specified timeout (in seconds).
    the timer is cancelled with Sender_StopTimer() is called or a new 
    Sender_StartTimer() is called before the current timer expires.
    Sender_Timeout() will be called when the timer expires. */
-void Sender_StartTimer(double timeout)
+void Sender_StartTimer(Simulation *sim, double timeout)
 {
-    if (tracing_level>=1)
+    EventChain &sim_core = sim->sim_core;
+
+    if (sim->cfg.tracing_level>=1)
 	fprintf(stdout, "Time %.2fs (Sender): the timer is started (expires at %.2fs).\n",
 		sim_core.time(), sim_core.time() + timeout);
 
-    if (sender_timer!=NULL) {
-	sim_core.cancel(sender_timer);
-	delete sender_timer;
-	sender_timer = NULL;
+    Connection *c = sim->conn;
+    if (c->sender_timer!=NULL) {
+	sim_core.cancel(c->sender_timer);
+	sim->timeout_event_pool.release(c->sender_timer);
+	c->sender_timer = NULL;
     }
 
-    EventSenderTimeout *e = new EventSenderTimeout;
+    EventSenderTimeout *e = sim->timeout_event_pool.alloc();
+    e->conn = c->id;
     e->sched_time = sim_core.time() + timeout;
     sim_core.schedule(e);
 
-    sender_timer = e;
+    c->sender_timer = e;
 }
 
 /* stop the sender timer */
-void Sender_StopTimer()
+void Sender_StopTimer(Simulation *sim)
 {
-    if (tracing_level>=1)
+    if (sim->cfg.tracing_level>=1)
 	fprintf(stdout, "Time %.2fs (Sender): the timer is stopped.\n", 
-		sim_core.time());
+		sim->sim_core.time());
 
-    if (sender_timer!=NULL) {
-	sim_core.cancel(sender_timer);
-	delete sender_timer;
-	sender_timer = NULL;
+    Connection *c = sim->conn;
+    if (c->sender_timer!=NULL) {
+	sim->sim_core.cancel(c->sender_timer);
+	sim->timeout_event_pool.release(c->sender_timer);
+	c->sender_timer = NULL;
     }
 }
 
 /* check whether the sender timer is being set,
    return true if the timer is set, return false otherwise */
-bool Sender_isTimerSet()
+bool Sender_isTimerSet(Simulation *sim)
+{
+    return (sim->conn->sender_timer!=NULL);
+}
+
+/* start the receiver timer with a specified timeout (in seconds) */
+void Receiver_StartTimer(Simulation *sim, double timeout)
+{
+    EventChain &sim_core = sim->sim_core;
+
+    if (sim->cfg.tracing_level>=1)
+	fprintf(stdout, "Time %.2fs (Receiver): the timer is started (expires at %.2fs).\n",
+		sim_core.time(), sim_core.time() + timeout);
+
+    Connection *c = sim->conn;
+    if (c->receiver_timer!=NULL) {
+	sim_core.cancel(c->receiver_timer);
+	sim->receiver_timeout_pool.release(c->receiver_timer);
+	c->receiver_timer = NULL;
+    }
+
+    EventReceiverTimeout *e = sim->receiver_timeout_pool.alloc();
+    e->conn = c->id;
+    e->sched_time = sim_core.time() + timeout;
+    sim_core.schedule(e);
+
+    c->receiver_timer = e;
+}
+
+/* stop the receiver timer */
+void Receiver_StopTimer(Simulation *sim)
+{
+    if (sim->cfg.tracing_level>=1)
+	fprintf(stdout, "Time %.2fs (Receiver): the timer is stopped.\n", 
+		sim->sim_core.time());
+
+    Connection *c = sim->conn;
+    if (c->receiver_timer!=NULL) {
+	sim->sim_core.cancel(c->receiver_timer);
+	sim->receiver_timeout_pool.release(c->receiver_timer);
+	c->receiver_timer = NULL;
+    }
+}
+
+/* check whether the receiver timer is being set */
+bool Receiver_isTimerSet(Simulation *sim)
 {
-    return (sender_timer!=NULL);
+    return (sim->conn->receiver_timer!=NULL);
+}
+
+/* direct a packet event off the link to the connection its header names,
+   return false if there is no such connection */
+template <class T>
+static bool demux(Simulation *sim, T *e)
+{
+    const struct sim_config &cfg = sim->cfg;
+    e->conn = GetConn(&e->pkt, cfg.check_width, cfg.size_width, cfg.seq_width,
+		      cfg.conn_width);
+    return e->conn<cfg.connections;
 }
 
 /* pass a packet to the lower layer at the sender */
-void Sender_ToLowerLayer(struct packet *pkt)
+void Sender_ToLowerLayer(Simulation *sim, struct packet *pkt)
 {
-    /* packet lost at rate "loss_rate" */
-    if (myrandom()<loss_rate) return;
+    /* packet dropped by the bottleneck queue, or lost */
+    if (!sim->forward.offer(&sim->rng, sim->sim_core.time(), pkt->size)) return;
 
-    EventReceiverFromLowerLayer *e = new EventReceiverFromLowerLayer;
-    memcpy(&e->pkt.data, pkt->data, RDT_PKTSIZE);
+    ASSERT(pkt->size>0 && pkt->size<=sim->cfg.mtu);
+    EventReceiverFromLowerLayer *e = sim->receiver_event_pool.alloc();
+    e->pkt.size = pkt->size;
+    e->pkt.data = sim->receiver_event_pool.trailer(e);
+    memcpy(e->pkt.data, pkt->data, pkt->size);
 
     /* packet corrupted at rate "corrupt_rate" */
-    if (myrandom()<corrupt_rate) {
-	for (int i=0; i<RDT_PKTSIZE; i++) {
-	    e->pkt.data[i] = e->pkt.data[i] + (char)(myrandom()*20) - 10;
+    if (myrandom(sim)<sim->cfg.corrupt_rate) {
+	for (int i=0; i<e->pkt.size; i++) {
+	    e->pkt.data[i] = e->pkt.data[i] + (char)(myrandom(sim)*20) - 10;
 	}
     }
 
-    /* schedule the packet arrival event at the other side */
-    if (myrandom()<outoforder_rate)
-	e->sched_time = sim_core.time() + pkt_latency*2.0*myrandom();
-    else
-	e->sched_time = sim_core.time() + pkt_latency;
-    sim_core.schedule(e);
+    sim->tot_pkts_passed ++;
+    sim->tot_bytes_passed += pkt->size;
+
+    /* the receiver of the connection the header names, which corruption
+       may have changed to one that does not exist */
+    if (!demux(sim, e)) {
+	sim->receiver_event_pool.release(e);
+	return;
+    }
 
-    tot_pkts_passed ++;
+    /* schedule the packet arrival event at the other side */
+    e->sched_time = sim->forward.arrival(&sim->rng);
+    sim->sim_core.schedule(e);
 }
 
 
 /* pass a packet to the lower layer at the receiver */
-void Receiver_ToLowerLayer(struct packet *pkt)
+void Receiver_ToLowerLayer(Simulation *sim, struct packet *pkt)
 {
-    /* packet lost at rate "loss_rate" */
-    if (myrandom()<loss_rate) return;
+    /* packet dropped by the bottleneck queue, or lost */
+    if (!sim->reverse.offer(&sim->rng, sim->sim_core.time(), pkt->size)) return;
 
-    EventSenderFromLowerLayer *e = new EventSenderFromLowerLayer;
-    memcpy(&e->pkt.data, pkt->data, RDT_PKTSIZE);
+    ASSERT(pkt->size>0 && pkt->size<=sim->cfg.mtu);
+    EventSenderFromLowerLayer *e = sim->sender_event_pool.alloc();
+    e->pkt.size = pkt->size;
+    e->pkt.data = sim->sender_event_pool.trailer(e);
+    memcpy(e->pkt.data, pkt->data, pkt->size);
 
     /* packet corrupted at rate "corrupt_rate" */
-    if (myrandom()<corrupt_rate) {
-	for (int i=0; i<RDT_PKTSIZE; i++) {
-	    e->pkt.data[i] = e->pkt.data[i] + (char)(myrandom()*20) - 10;
+    if (myrandom(sim)<sim->cfg.corrupt_rate) {
+	for (int i=0; i<e->pkt.size; i++) {
+	    e->pkt.data[i] = e->pkt.data[i] + (char)(myrandom(sim)*20) - 10;
 	}
     }
 
-    /* schedule the packet arrival event at the other side */
-    if (myrandom()<outoforder_rate)
-	e->sched_time = sim_core.time() + pkt_latency*2.0*myrandom();
-    else
-	e->sched_time = sim_core.time() + pkt_latency;	
-    sim_core.schedule(e);
+    sim->tot_pkts_passed ++;
+    sim->tot_bytes_passed += pkt->size;
 
-    tot_pkts_passed ++;
+    /* likewise the sender of the connection the header names */
+    if (!demux(sim, e)) {
+	sim->sender_event_pool.release(e);
+	return;
+    }
+
+    /* schedule the packet arrival event at the other side */
+    e->sched_time = sim->reverse.arrival(&sim->rng);
+    sim->sim_core.schedule(e);
 }
 
 /* deliver a message to the upper layer at the receiver 
    NOTE: change the message verification in this function if you changed 
-         generate_msg() for testing. */
-void Receiver_ToUpperLayer(struct message *msg)
+	 generate_msg() for testing. */
+void Receiver_ToUpperLayer(Simulation *sim, struct message *msg)
 {
-    static char cnt = 0;
-
+    Connection *c = sim->conn;
     for (int i=0; i<msg->size; i++) {
 	/* message verification */
-	if (msg->data[i] != '0' + cnt) {
-	    message_verfication_passed = false;
+	if (msg->data[i] != '0' + c->verify_cnt) {
+	    sim->message_verfication_passed = false;
 	}
-	cnt = (cnt+1) % 10;
+	c->verify_cnt = (c->verify_cnt+1) % 10;
 
-	if (tracing_level>=2)
+	if (sim->cfg.tracing_level>=2)
 	    fputc(msg->data[i], stdout);
     }
 
-    tot_chars_delivered += msg->size;
+    sim->tot_chars_delivered += msg->size;
+    c->chars_delivered += msg->size;
     //tot_chars_delivered++;
+
+    /* messages come up whole, in the order they were generated */
+    if (c->msg_stamps.empty() || c->msg_stamps.front().size!=msg->size) {
+	sim->message_verfication_passed = false;
+    }
+    else {
+	double latency = sim->sim_core.time() - c->msg_stamps.front().time;
+	c->msg_stamps.pop_front();
+	sim->latency.add(latency);
+	sim->series_record(latency);
+    }
 }
 
 
@@ -353,94 +426,210 @@ void Receiver_ToUpperLayer(struct message *msg)
   |  main simulation control routine
   []------------------------------------------------------------------------[]*/
 
-int main(int argc, char *argv[])
+Simulation::Simulation(const struct sim_config *cfg)
+    : sim_core(EventQueue_Create(cfg->queue_kind, cfg->wheel_tick)),
+      upper_event_pool("sender from upper layer"),
+      sender_event_pool("sender from lower layer", cfg->mtu),
+      timeout_event_pool("sender timeout"),
+      receiver_event_pool("receiver from lower layer", cfg->mtu),
+      receiver_timeout_pool("receiver timeout")
 {
-    if (argc!=8) {
-	fprintf(stderr, "usage: %s <sim_time> <mean_msg_arrivalint> <mean_msg_size> "
-		"<outoforder_rate> <loss_rate> <corrupt_rate> <tracing_level>\n", 
-		argv[0]);
-	exit(-1);
+    this->cfg = *cfg;
+    conns.resize(cfg->connections);
+    for (int c = 0; c<cfg->connections; c++) {
+	Connection *k = &conns[c];
+	k->id = c;
+	k->sender = NULL;
+	k->receiver = NULL;
+	k->sender_timer = NULL;
+	k->receiver_timer = NULL;
+	k->workload = Workload_Create(cfg->workload, cfg->msg_arrivalint,
+				      cfg->msg_size, cfg->msg_max>0
+				      ? cfg->msg_max : 64*cfg->msg_size);
+	ASSERT(k->workload!=NULL);
+	k->generate_cnt = 0;
+	k->verify_cnt = 0;
+	k->chars_sent = 0;
+	k->chars_delivered = 0;
+	memset(&k->flow, 0, sizeof(k->flow));
+	k->held_msg = NULL;
+	k->held_e = NULL;
     }
+    conn = &conns[0];
+    this->cfg.msg_max = conn->workload->max_size();
+    pkt_latency = 0.1;
+    forward.setup(&cfg->link, cfg->loss_rate, cfg->outoforder_rate, pkt_latency);
+    reverse.setup(&cfg->link, cfg->loss_rate, cfg->outoforder_rate, pkt_latency);
+    tot_chars_sent = 0;
+    tot_chars_delivered = 0;
+    tot_pkts_passed = 0;
+    tot_bytes_passed = 0;
+    tot_msgs_blocked = 0;
+    tot_msgs_dropped = 0;
+    tot_chars_dropped = 0;
+    memset(&stats, 0, sizeof(stats));
+    rto_log = NULL;
+    cwnd_log = NULL;
+    trace = NULL;
+    series_log = NULL;
+    series_interval = 1.0;
+    series_end = 0;
+    series_chars = 0;
+    series_sent = 0;
+    series_resent = 0;
+    series_msgs = 0;
+    series_latency_sum = 0;
+    series_latency_max = 0;
+    message_verfication_passed = true;
+    rng.seed_with(cfg->seed);
+    sender = NULL;
+    receiver = NULL;
+}
 
-    sim_time = atof(argv[1]);
-    if (sim_time<=0) {
-	fprintf(stderr, "invalid <sim_time>\n");
-	exit(-1);
-    }
-    msg_arrivalint = atof(argv[2]);
-    if (msg_arrivalint<=0) {
-	fprintf(stderr, "invalid <msg_arrivalint>\n");
-	exit(-1);
-    }
-    msg_size = atoi(argv[3]);
-    if (msg_size<=0) {
-	fprintf(stderr, "invalid <msg_size>\n");
-	exit(-1);
-    }
-    outoforder_rate = atof(argv[4]);
-    if (outoforder_rate<0 || outoforder_rate>1) {
-	fprintf(stderr, "invalid <outoforder_rate>\n");
-	exit(-1);
+Simulation::~Simulation()
+{
+    for (size_t c = 0; c<conns.size(); c++)
+	delete conns[c].workload;
+}
+
+double Simulation::mean_cwnd(int c)
+{
+    const struct rdt_flow_stats *flow = &conns[c].flow;
+    double now = sim_core.time();
+    if (flow->cwnd_updates==0) return 0;
+    if (now<=0) return flow->cwnd;
+    return (flow->cwnd_area + flow->cwnd*(now-flow->cwnd_time))/now;
+}
+
+double Simulation::mean_cwnd()
+{
+    double sum = 0;
+    int n = 0;
+    for (size_t c = 0; c<conns.size(); c++) {
+	if (conns[c].flow.cwnd_updates==0) continue;
+	sum += mean_cwnd(c);
+	n++;
     }
-    loss_rate = atof(argv[5]);
-    if (loss_rate<0 || loss_rate>1) {
-	fprintf(stderr, "invalid <loss_rate>\n");
-	exit(-1);
+    return n>0 ? sum/n : 0;
+}
+
+void Simulation::mean_flow(struct rdt_flow_stats *mean)
+{
+    int rto_flows = 0, cwnd_flows = 0;
+    memset(mean, 0, sizeof(*mean));
+    for (size_t c = 0; c<conns.size(); c++) {
+	const struct rdt_flow_stats *flow = &conns[c].flow;
+	if (flow->rto_updates>0) {
+	    mean->srtt += flow->srtt;
+	    mean->rttvar += flow->rttvar;
+	    mean->rto += flow->rto;
+	    rto_flows++;
+	}
+	if (flow->cwnd_updates>0) {
+	    mean->cwnd += flow->cwnd;
+	    mean->ssthresh += flow->ssthresh;
+	    cwnd_flows++;
+	}
+	mean->rto_updates += flow->rto_updates;
+	mean->cwnd_updates += flow->cwnd_updates;
     }
-    corrupt_rate = atof(argv[6]);
-    if (corrupt_rate<0 || corrupt_rate>1) {
-	fprintf(stderr, "invalid <corrupt_rate>\n");
-	exit(-1);
+    if (rto_flows>0) {
+	mean->srtt /= rto_flows;
+	mean->rttvar /= rto_flows;
+	mean->rto /= rto_flows;
     }
-    tracing_level = atoi(argv[7]);
-    if (tracing_level<0 || tracing_level>2) {
-	fprintf(stderr, "invalid <tracing_level>\n");
-	exit(-1);
+    if (cwnd_flows>0) {
+	mean->cwnd /= cwnd_flows;
+	mean->ssthresh /= cwnd_flows;
     }
-    
-    fprintf(stdout, "## Reliable data transfer simulation with:\n"
-	    "\tsimulation time is %.3f seconds\n"
-	    "\taverage message arrival interval is %.3f seconds\n"
-	    "\taverage message size is %d bytes\n"
-	    "\taverage out-of-order delivery rate is %.2f%%\n"
-	    "\taverage loss rate is %.2f%%\n"
-	    "\taverage corrupt rate is %.2f%%\n"
-	    "\ttracing level is %d\n"
-	    "Please review these inputs and press <enter> to proceed.\n",
-	    sim_time, msg_arrivalint, msg_size, outoforder_rate*100.0, 
-	    loss_rate*100.0, corrupt_rate*100.0, tracing_level);
-    fgetc(stdin);
+}
 
-    /* initialize the random number generator */
-    srand(getpid()+getppid());
+double Simulation::goodput(int c)
+{
+    double now = sim_core.time();
+    return now>0 ? conns[c].chars_delivered/now : 0;
+}
 
-    /* test the random number generator */
-    double randtest_sum = 0.0;
-    for (int i=0; i<1000; i++)
-	randtest_sum += myrandom();
-    double randtest_avg = randtest_sum/1000;
-    if (randtest_avg<0.25 || randtest_avg>0.75) {
-	fprintf(stderr, 
-		"It appears that something is wrong with the random number.\n"
-		"Please try to run this again.\n"  
-		"Please report to me if the problem PERSISTS.\n");
-	exit(-1);
+double Simulation::fairness()
+{
+    double sum = 0, sum_squares = 0;
+    for (size_t c = 0; c<conns.size(); c++) {
+	double x = goodput(c);
+	sum += x;
+	sum_squares += x*x;
     }
+    return sum_squares>0 ? sum*sum/(conns.size()*sum_squares) : 1;
+}
 
-    /* intialize the sender and the receiver */
-    Sender_Init();
-    Receiver_Init();
+void Simulation::series_record(double latency)
+{
+    series_msgs++;
+    series_latency_sum += latency;
+    if (latency>series_latency_max) series_latency_max = latency;
+}
 
-    /* scheduling a recurring message arrival event */
-    EventSenderFromUpperLayer *e = new EventSenderFromUpperLayer;
-    e->sched_time = 0;
-    sim_core.schedule(e);
+void Simulation::log_series(bool final)
+{
+    double now = sim_core.time();
+    if (series_end==0) series_end = series_interval;
+    while (series_end<=now || final) {
+	double start = series_end - series_interval;
+	double end = series_end<=now ? series_end : now;
+	if (end<=start) break;
+	int sent = stats.pkts_sent - series_sent;
+	int waiting = 0;
+	for (size_t c = 0; c<conns.size(); c++) {
+	    select(c);
+	    waiting += Sender_Waiting(this);
+	}
+	fprintf(series_log, "%.6f,%.3f,%.4f,%d,%d,%.6f,%.6f\n", end,
+		(tot_chars_delivered - series_chars)/(end - start),
+		sent>0 ? (double)(stats.pkts_retransmitted - series_resent)/sent : 0,
+		waiting, series_msgs,
+		series_msgs>0 ? series_latency_sum/series_msgs : 0,
+		series_latency_max);
+	series_chars = tot_chars_delivered;
+	series_sent = stats.pkts_sent;
+	series_resent = stats.pkts_retransmitted;
+	series_msgs = 0;
+	series_latency_sum = 0;
+	series_latency_max = 0;
+	if (end<series_end) break;
+	series_end += series_interval;
+    }
+}
+
+void Simulation::run()
+{
+    int tracing_level = cfg.tracing_level;
+
+    for (int c = 0; c<cfg.connections; c++) {
+	select(c);
+
+	/* intialize the sender and the receiver */
+	Sender_Init(this);
+	Receiver_Init(this);
+	conn->sender = sender;
+	conn->receiver = receiver;
+
+	/* scheduling a recurring message arrival event */
+	EventSenderFromUpperLayer *e = upper_event_pool.alloc();
+	e->conn = c;
+	e->sched_time = conn->workload->start();
+	sim_core.schedule(e);
+    }
 
     /* main simulation cycle */
     for (;;) {
 	Event *e = sim_core.next_event();
 	if (e==NULL) break;
 
+	/* the intervals of the time series that end before this event */
+	if (series_log!=NULL) log_series(false);
+
+	/* every event belongs to a connection */
+	select(static_cast<ConnectionEvent*>(e)->conn);
+
 	switch (e->event_type) {
 	case EVENT_SENDER_FROMUPPERLAYER:
 	    {
@@ -450,18 +639,29 @@ int main(int argc, char *argv[])
 
 		EventSenderFromUpperLayer *real_e = (EventSenderFromUpperLayer*) e;
 
-		struct message *msg = generate_msg();
-		Sender_FromUpperLayer(msg);
-		free_msg(msg);
+		struct message *msg = generate_msg(this);
+		if (Sender_Writable(this, msg->size)) {
+		    Sender_FromUpperLayer(this, msg);
+		    free_msg(msg);
+		}
+		else if (cfg.wait_drop) {
+		    if (tracing_level>=1) {
+			fprintf(stdout, "Time %.2fs (Sender): no room at the rdt layer, the message is dropped.\n", sim_core.time());
+		    }
+		    drop_msg(this, msg);
+		}
+		else {
+		    if (tracing_level>=1) {
+			fprintf(stdout, "Time %.2fs (Sender): no room at the rdt layer, the upper layer holds the message.\n", sim_core.time());
+		    }
+		    tot_msgs_blocked++;
+		    conn->held_msg = msg;
+		    conn->held_e = real_e;
+		    break;
+		}
 
 		/* schedule the recurring event */
-		if (sim_core.time() < sim_time) {
-		    real_e->sched_time = 
-			sim_core.time() + msg_arrivalint*2.0*myrandom();
-		    sim_core.schedule(real_e);
-		}
-		else
-		    delete real_e;
+		schedule_arrival(this, real_e);
 	    }
 	    break;
 
@@ -473,9 +673,19 @@ int main(int argc, char *argv[])
 
 		EventSenderFromLowerLayer *real_e = (EventSenderFromLowerLayer*) e;
 
-		Sender_FromLowerLayer(&real_e->pkt);
+		Sender_FromLowerLayer(this, &real_e->pkt);
+
+		sender_event_pool.release(real_e);
 
-		delete real_e;
+		/* the acks may have made room for the message held, the
+		   arrivals resume once it is passed down */
+		struct message *held_msg = conn->held_msg;
+		if (held_msg!=NULL && Sender_Writable(this, held_msg->size)) {
+		    Sender_FromUpperLayer(this, held_msg);
+		    free_msg(held_msg);
+		    conn->held_msg = NULL;
+		    schedule_arrival(this, conn->held_e);
+		}
 	    }
 	    break;
 
@@ -486,10 +696,10 @@ int main(int argc, char *argv[])
 		}
 
 		EventSenderTimeout *real_e = (EventSenderTimeout*) e;
-		delete real_e;
-		sender_timer = NULL;
+		timeout_event_pool.release(real_e);
+		conn->sender_timer = NULL;
 
-		Sender_Timeout();
+		Sender_Timeout(this);
 	    }
 	    break;
 
@@ -501,9 +711,23 @@ int main(int argc, char *argv[])
 
 		EventReceiverFromLowerLayer *real_e = (EventReceiverFromLowerLayer*) e;
 		
-		Receiver_FromLowerLayer(&real_e->pkt);
+		Receiver_FromLowerLayer(this, &real_e->pkt);
 
-		delete real_e;
+		receiver_event_pool.release(real_e);
+	    }
+	    break;
+
+	case EVENT_RECEIVER_TIMEOUT:
+	    {
+		if (tracing_level>=1) {
+		    fprintf(stdout, "Time %.2fs (Receiver): the timer expires.\n", sim_core.time());
+		}
+
+		EventReceiverTimeout *real_e = (EventReceiverTimeout*) e;
+		receiver_timeout_pool.release(real_e);
+		conn->receiver_timer = NULL;
+
+		Receiver_Timeout(this);
 	    }
 	    break;
 
@@ -513,21 +737,731 @@ int main(int argc, char *argv[])
 	}
     }
 
-    /* finalize the sender and the receiver */
-    Sender_Final();
-    Receiver_Final();
+    if (series_log!=NULL) log_series(true);
+
+    for (int c = 0; c<cfg.connections; c++) {
+	select(c);
+
+	/* packets in flight keep the simulation going while a message is
+	   held */
+	ASSERT(conn->held_msg==NULL);
+
+	/* finalize the sender and the receiver */
+	Sender_Final(this);
+	Receiver_Final(this);
+    }
+}
+
+void SimConfig_Default(struct sim_config *cfg)
+{
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->queue_kind = "heap4";
+    cfg->wheel_tick = 0.001;
+    cfg->adaptive_rto = false;
+    cfg->window_size = WINDOW_SIZE;
+    cfg->seq_width = SeqWidthFor(WINDOW_SIZE, 1);
+    cfg->mtu = RDT_PKTSIZE;
+    cfg->size_width = SizeWidth(RDT_PKTSIZE);
+    cfg->check_kind = CHECK_SUM16;
+    cfg->check_width = CheckWidth(CHECK_SUM16);
+    cfg->sack = false;
+    cfg->fast_retransmit = false;
+    cfg->cc_kind = "none";
+    cfg->ack_every = 1;
+    cfg->fec_block = 0;
+    cfg->coalesce = false;
+    cfg->coalesce_delay = 0.02;
+    cfg->ack_delay = 0.05;
+    cfg->wait_buffer = WAIT_BUFFER_SIZE;
+    cfg->wait_drop = false;
+    cfg->workload = "uniform";
+    cfg->msg_max = 0;
+    cfg->connections = 1;
+    cfg->conn_width = 0;
+    cfg->link.rate = 0;
+    cfg->link.queue_limit = 100;
+    cfg->link.aqm = LINK_DROPTAIL;
+    cfg->link.burst = false;
+    cfg->link.delay_kind = DELAY_CLASSIC;
+    cfg->link.jitter = 0.02;
+    cfg->seed = 1;
+}
+
+#ifndef RDT_NO_MAIN
+
+/* the wait buffer of each of n connections sharing the default one, no
+   less than WAIT_BUFFER_MIN packets */
+static int shared_wait_buffer(int n)
+{
+    const int WAIT_BUFFER_MIN = 64;
+    int size = WAIT_BUFFER_SIZE/n;
+    return size>WAIT_BUFFER_MIN ? size : WAIT_BUFFER_MIN;
+}
+
+/* batch mode runner, each scenario gets a simulation of its own */
+static void run_scenario(const struct batch_scenario *sc, struct batch_result *res)
+{
+    struct sim_config cfg = config;
+    cfg.sim_time = sc->sim_time;
+    cfg.msg_arrivalint = sc->msg_arrivalint;
+    cfg.msg_size = sc->msg_size;
+    cfg.outoforder_rate = sc->outoforder_rate;
+    cfg.loss_rate = sc->loss_rate;
+    cfg.corrupt_rate = sc->corrupt_rate;
+    cfg.tracing_level = 0;
+    cfg.seed = sc->seed;
+    cfg.window_size = sc->window_size;
+    cfg.seq_width = SeqWidthFor(sc->window_size, seq_width_min);
+    cfg.mtu = sc->mtu;
+    cfg.size_width = SizeWidth(sc->mtu);
+    cfg.link.rate = sc->link_rate;
+    cfg.connections = sc->connections;
+    cfg.conn_width = ConnWidth(sc->connections);
+    if (!wait_buffer_set) cfg.wait_buffer = shared_wait_buffer(sc->connections);
+
+    Simulation *sim = new Simulation(&cfg);
+    sim->run();
+
+    res->passed = sim->passed();
+    res->end_time = sim->sim_core.time();
+    res->chars_sent = sim->tot_chars_sent;
+    res->chars_delivered = sim->tot_chars_delivered;
+    res->pkts_passed = sim->tot_pkts_passed;
+    res->pkts_retransmitted = sim->stats.pkts_retransmitted;
+    res->pkts_fast_retransmitted = sim->stats.pkts_fast_retransmitted;
+    res->queue_drops = sim->forward.queue_drops() + sim->reverse.queue_drops();
+    res->mean_rto = sim->stats.rto_updates>0 
+	? sim->stats.rto_sum/sim->stats.rto_updates : 0;
+    res->mean_cwnd = sim->mean_cwnd();
+    res->events = sim->sim_core.processed;
+    res->latency_p50 = sim->latency.percentile(0.5);
+    res->latency_p99 = sim->latency.percentile(0.99);
+    res->latency_p999 = sim->latency.percentile(0.999);
+    res->fairness = sim->fairness();
+    delete sim;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [options] <sim_time> <mean_msg_arrivalint> <mean_msg_size> "
+	    "<outoforder_rate> <loss_rate> <corrupt_rate> <tracing_level>\n"
+	    "options:\n"
+	    "\t--queue=list|heap|heap4|wheel  event queue engine (default heap4)\n"
+	    "\t--wheel-tick=<seconds>         slot granularity of the wheel (default 0.001)\n"
+	    "\t--seed=<n>                     seed of the random number generator, the same\n"
+	    "\t                               seed reproduces the same run\n"
+	    "\t--no-prompt                    do not wait for <enter> before starting\n"
+	    "\t--window=<n>                   window of the sender and the receiver, in\n"
+	    "\t                               packets (default 10)\n"
+	    "\t--seq-bits=8|16|32             least width of the sequence field, widened as\n"
+	    "\t                               the window requires (default 8)\n"
+	    "\t--mtu=<bytes>                  largest packet of the link, headers included,\n"
+	    "\t                               %d to %d (default %d)\n"
+	    "\t--check=sum16|crc32c           integrity code of the packets, the 16-bit\n"
+	    "\t                               checksum or CRC32C (default sum16)\n"
+	    "\t--sack                         selective acks, the receiver reports the\n"
+	    "\t                               packets it holds out of order\n"
+	    "\t--fast-retransmit              resend the oldest packet after 3 duplicate acks\n"
+	    "\t--workload=<spec>              the messages of the upper layer, uniform (the\n"
+	    "\t                               default), pareto[:alpha], lognormal[:sigma],\n"
+	    "\t                               onoff[:on,off] or trace:<file> of\n"
+	    "\t                               timestamp,size lines\n"
+	    "\t--msg-max=<bytes>              largest pareto or lognormal message (default\n"
+	    "\t                               64 times the mean size)\n"
+	    "\t--wait-buffer=<n>              room for packets waiting for the window at the\n"
+	    "\t                               sender (default 4096, shared among the\n"
+	    "\t                               connections down to 64 each)\n"
+	    "\t--wait-full=block|drop         the upper layer holds a message finding no room\n"
+	    "\t                               and stops generating, or drops it (default block)\n"
+	    "\t--ack-every=<n>                the receiver acks every n in-order packets\n"
+	    "\t                               (default 1)\n"
+	    "\t--ack-delay=<seconds>          longest an in-order packet waits for its ack\n"
+	    "\t                               when acks are coalesced (default 0.05)\n"
+	    "\t--coalesce                     pack small messages together into packets\n"
+	    "\t--coalesce-delay=<seconds>     longest a packet waits to be filled when\n"
+	    "\t                               coalescing (default 0.02)\n"
+	    "\t--connections=<n>              connections sharing the link, up to %d, each\n"
+	    "\t                               with a workload of its own (default 1)\n"
+	    "\t--flow-log=<file>              write the goodput of each connection as CSV\n"
+	    "\t                               rows of conn,chars_sent,chars_delivered,goodput\n"
+	    "\t--rate=<bytes/s>               bottleneck of the link, each way (default none)\n"
+	    "\t--link-queue=<n>               packets queued for the bottleneck (default 100)\n"
+	    "\t--aqm=droptail|red             the queue drops arrivals when full, or early\n"
+	    "\t                               with RED (default droptail)\n"
+	    "\t--burst-loss=<p>,<r>[,<h>]     Gilbert-Elliott loss: into the bad state with p,\n"
+	    "\t                               out with r, losing h there (default 1) and\n"
+	    "\t                               <loss_rate> in the good state\n"
+	    "\t--delay=classic|uniform|normal|exp\n"
+	    "\t                               delay of the link: 100ms, <outoforder_rate> of\n"
+	    "\t                               it anything up to 200ms (classic), or 100ms\n"
+	    "\t                               plus jitter drawn from a distribution\n"
+	    "\t--jitter=<seconds>             spread of the jitter (default 0.02)\n"
+	    "\t--fec=<k>                      forward error correction, an XOR parity packet\n"
+	    "\t                               after every k packets, k a power of two up to 64\n"
+	    "\t--cc=none|reno|cubic           congestion control of the sender (default none)\n"
+	    "\t--cwnd-log=<file>              log every congestion window the sender takes as\n"
+	    "\t                               CSV rows of time,conn,cwnd,ssthresh\n"
+	    "\t--rto=fixed|adaptive           retransmission timeout of the sender, fixed or\n"
+	    "\t                               estimated from round trip times (default fixed)\n"
+	    "\t--series=<file>                log the run as CSV rows of time,goodput,\n"
+	    "\t                               retransmission_ratio,waiting,messages,\n"
+	    "\t                               latency_mean,latency_max, one per interval\n"
+	    "\t--series-interval=<seconds>    interval of the time series (default 1)\n"
+	    "\t--latency-log=<file>           write the message latency histogram as CSV\n"
+	    "\t                               rows of lower,upper,count,cumulative\n"
+	    "\t--rto-log=<file>               log every RTO the sender takes as CSV rows of\n"
+	    "\t                               time,conn,srtt,rttvar,rto\n"
+	    "\t--trace-file=<file>            record the events of the rdt layers into a ring\n"
+	    "\t                               written here at the end, decoded by rdt_tracedump\n"
+	    "\t--trace-ring=<n>               events the ring keeps, the last of the run\n"
+	    "\t                               (default 1048576)\n"
+	    "\t--batch=<sweep spec>           run a parameter sweep instead, e.g.\n"
+	    "\t                               \"loss=0:0.3:0.1;size=100,200;seed=1:4\"\n"
+	    "\t--jobs=<n>                     simulations run at a time in batch mode\n"
+	    "\t                               (default one per core)\n"
+	    "\t--workers=thread|process       run batch simulations on threads or in\n"
+	    "\t                               isolated child processes (default thread)\n"
+	    "\t--format=csv|json              batch result rows (default csv)\n"
+	    "in batch mode the positional arguments are left out, and so are the\n"
+	    "logs and the trace file.\n",
+	    prog, MTU_MIN, RDT_PKTSIZE_MAX, RDT_PKTSIZE, CONN_MAX);
+    exit(-1);
+}
+
+/* parse a --name=value option, return false if it is not recognized */
+static bool parse_option(const char *arg)
+{
+    if (strcmp(arg, "--no-prompt")==0) {
+	no_prompt = true;
+	return true;
+    }
+    if (strcmp(arg, "--fast-retransmit")==0) {
+	config.fast_retransmit = true;
+	return true;
+    }
+    if (strcmp(arg, "--coalesce")==0) {
+	config.coalesce = true;
+	return true;
+    }
+    if (strcmp(arg, "--sack")==0) {
+	config.sack = true;
+	return true;
+    }
+
+    const char *value = strchr(arg, '=');
+    if (value==NULL) return false;
+    value++;
+
+    if (strncmp(arg, "--queue=", value-arg)==0) {
+	config.queue_kind = value;
+	return true;
+    }
+    if (strncmp(arg, "--wheel-tick=", value-arg)==0) {
+	config.wheel_tick = atof(value);
+	return config.wheel_tick>0;
+    }
+    if (strncmp(arg, "--seed=", value-arg)==0) {
+	char *end;
+	config.seed = (unsigned int)strtoul(value, &end, 0);
+	seed_set = true;
+	return *value!='\0' && *end=='\0';
+    }
+    if (strncmp(arg, "--window=", value-arg)==0) {
+	config.window_size = atoi(value);
+	return config.window_size>0 && config.window_size<=WINDOW_MAX;
+    }
+    if (strncmp(arg, "--seq-bits=", value-arg)==0) {
+	seq_width_min = atoi(value)/8;
+	return strcmp(value, "8")==0 || strcmp(value, "16")==0 
+	    || strcmp(value, "32")==0;
+    }
+    if (strncmp(arg, "--mtu=", value-arg)==0) {
+	config.mtu = atoi(value);
+	config.size_width = SizeWidth(config.mtu);
+	return config.mtu>=MTU_MIN && config.mtu<=RDT_PKTSIZE_MAX;
+    }
+    if (strncmp(arg, "--check=", value-arg)==0) {
+	config.check_kind = CheckKind(value);
+	config.check_width = CheckWidth(config.check_kind);
+	return config.check_kind>=0;
+    }
+    if (strncmp(arg, "--rto=", value-arg)==0) {
+	config.adaptive_rto = strcmp(value, "adaptive")==0;
+	return config.adaptive_rto || strcmp(value, "fixed")==0;
+    }
+    if (strncmp(arg, "--workload=", value-arg)==0) {
+	config.workload = value;
+	return true;
+    }
+    if (strncmp(arg, "--msg-max=", value-arg)==0) {
+	config.msg_max = atoi(value);
+	return config.msg_max>0;
+    }
+    if (strncmp(arg, "--wait-buffer=", value-arg)==0) {
+	config.wait_buffer = atoi(value);
+	wait_buffer_set = true;
+	return config.wait_buffer>0;
+    }
+    if (strncmp(arg, "--wait-full=", value-arg)==0) {
+	config.wait_drop = strcmp(value, "drop")==0;
+	return config.wait_drop || strcmp(value, "block")==0;
+    }
+    if (strncmp(arg, "--ack-every=", value-arg)==0) {
+	config.ack_every = atoi(value);
+	return config.ack_every>0;
+    }
+    if (strncmp(arg, "--ack-delay=", value-arg)==0) {
+	config.ack_delay = atof(value);
+	return config.ack_delay>0;
+    }
+    if (strncmp(arg, "--coalesce-delay=", value-arg)==0) {
+	config.coalesce_delay = atof(value);
+	return config.coalesce_delay>0;
+    }
+    if (strncmp(arg, "--connections=", value-arg)==0) {
+	config.connections = atoi(value);
+	return config.connections>0 && config.connections<=CONN_MAX;
+    }
+    if (strncmp(arg, "--flow-log=", value-arg)==0) {
+	flow_log_path = value;
+	return true;
+    }
+    if (strncmp(arg, "--rate=", value-arg)==0) {
+	config.link.rate = atof(value);
+	return config.link.rate>=0;
+    }
+    if (strncmp(arg, "--link-queue=", value-arg)==0) {
+	config.link.queue_limit = atoi(value);
+	return config.link.queue_limit>0;
+    }
+    if (strncmp(arg, "--aqm=", value-arg)==0) {
+	config.link.aqm = LinkAqm(value);
+	return config.link.aqm>=0;
+    }
+    if (strncmp(arg, "--burst-loss=", value-arg)==0) {
+	config.link.burst = true;
+	config.link.burst_h = 1;
+	int n = sscanf(value, "%lf,%lf,%lf", &config.link.burst_p,
+		       &config.link.burst_r, &config.link.burst_h);
+	return n>=2 && config.link.burst_p>=0 && config.link.burst_p<=1
+	    && config.link.burst_r>=0 && config.link.burst_r<=1
+	    && config.link.burst_h>=0 && config.link.burst_h<=1;
+    }
+    if (strncmp(arg, "--delay=", value-arg)==0) {
+	config.link.delay_kind = LinkDelayKind(value);
+	return config.link.delay_kind>=0;
+    }
+    if (strncmp(arg, "--jitter=", value-arg)==0) {
+	config.link.jitter = atof(value);
+	return config.link.jitter>=0;
+    }
+    if (strncmp(arg, "--fec=", value-arg)==0) {
+	config.fec_block = atoi(value);
+	return config.fec_block>=2 && config.fec_block<=FEC_BLOCK_MAX
+	    && (config.fec_block & (config.fec_block-1))==0;
+    }
+    if (strncmp(arg, "--cc=", value-arg)==0) {
+	config.cc_kind = value;
+	return true;
+    }
+    if (strncmp(arg, "--cwnd-log=", value-arg)==0) {
+	cwnd_log_path = value;
+	return true;
+    }
+    if (strncmp(arg, "--series=", value-arg)==0) {
+	series_path = value;
+	return true;
+    }
+    if (strncmp(arg, "--series-interval=", value-arg)==0) {
+	series_interval = atof(value);
+	return series_interval>0;
+    }
+    if (strncmp(arg, "--latency-log=", value-arg)==0) {
+	latency_log_path = value;
+	return true;
+    }
+    if (strncmp(arg, "--rto-log=", value-arg)==0) {
+	rto_log_path = value;
+	return true;
+    }
+    if (strncmp(arg, "--trace-file=", value-arg)==0) {
+	trace_path = value;
+	return true;
+    }
+    if (strncmp(arg, "--trace-ring=", value-arg)==0) {
+	trace_ring_size = atoi(value);
+	return trace_ring_size>0;
+    }
+    if (strncmp(arg, "--batch=", value-arg)==0) {
+	batch_spec = value;
+	return true;
+    }
+    if (strncmp(arg, "--jobs=", value-arg)==0) {
+	batch_jobs = atoi(value);
+	return batch_jobs>0;
+    }
+    if (strncmp(arg, "--workers=", value-arg)==0) {
+	batch_workers = value;
+	return strcmp(value, "thread")==0 || strcmp(value, "process")==0;
+    }
+    if (strncmp(arg, "--format=", value-arg)==0) {
+	batch_format = value;
+	return true;
+    }
+    return false;
+}
+
+int main(int argc, char *argv[])
+{
+    SimConfig_Default(&config);
+
+    /* without --seed every run is seeded differently */
+    config.seed = getpid()+getppid();
+
+    /* options go ahead of the positional arguments */
+    int argi = 1;
+    for (; argi<argc && strncmp(argv[argi], "--", 2)==0; argi++) {
+	if (!parse_option(argv[argi])) {
+	    fprintf(stderr, "invalid option %s\n", argv[argi]);
+	    usage(argv[0]);
+	}
+    }
+    if (argc-argi!=(batch_spec!=NULL ? 0 : 7)) usage(argv[0]);
+    config.conn_width = ConnWidth(config.connections);
+    argv += argi-1;
+
+    EventQueue *probe = EventQueue_Create(config.queue_kind, config.wheel_tick);
+    if (probe==NULL) {
+	fprintf(stderr, "invalid event queue %s\n", config.queue_kind);
+	exit(-1);
+    }
+    delete probe;
+
+    CongestionControl *cc_probe = CongestionControl_Create(config.cc_kind, 1);
+    if (cc_probe==NULL) {
+	fprintf(stderr, "invalid congestion control %s\n", config.cc_kind);
+	exit(-1);
+    }
+    delete cc_probe;
+
+    Workload *workload_probe = Workload_Create(config.workload, 1, 1, 1);
+    if (workload_probe==NULL) exit(-1);
+    delete workload_probe;
+
+    if (batch_spec!=NULL) {
+	/* the logs are of a single run, a sweep has no file for each */
+	if (rto_log_path!=NULL || cwnd_log_path!=NULL || series_path!=NULL
+	    || latency_log_path!=NULL || flow_log_path!=NULL
+	    || trace_path!=NULL) {
+	    fprintf(stderr, "--cwnd-log, --rto-log, --series, --latency-log, "
+		    "--flow-log and --trace-file do not go with --batch\n");
+	    exit(-1);
+	}
+	if (batch_jobs==0) batch_jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if (batch_jobs<1) batch_jobs = 1;
+	/* the keys the spec leaves out follow the command line */
+	struct batch_scenario defaults;
+	Batch_Defaults(&defaults);
+	defaults.window_size = config.window_size;
+	defaults.mtu = config.mtu;
+	defaults.link_rate = config.link.rate;
+	defaults.connections = config.connections;
+	if (seed_set) defaults.seed = config.seed;
+	int failed = Batch_Run(batch_spec, &defaults, batch_jobs, 
+			       strcmp(batch_workers, "process")==0,
+			       batch_format, run_scenario);
+	return failed==0 ? 0 : -1;
+    }
+
+    config.sim_time = atof(argv[1]);
+    if (config.sim_time<=0) {
+	fprintf(stderr, "invalid <sim_time>\n");
+	exit(-1);
+    }
+    config.msg_arrivalint = atof(argv[2]);
+    if (config.msg_arrivalint<=0) {
+	fprintf(stderr, "invalid <msg_arrivalint>\n");
+	exit(-1);
+    }
+    config.msg_size = atoi(argv[3]);
+    if (config.msg_size<=0) {
+	fprintf(stderr, "invalid <msg_size>\n");
+	exit(-1);
+    }
+    config.outoforder_rate = atof(argv[4]);
+    if (config.outoforder_rate<0 || config.outoforder_rate>1) {
+	fprintf(stderr, "invalid <outoforder_rate>\n");
+	exit(-1);
+    }
+    config.loss_rate = atof(argv[5]);
+    if (config.loss_rate<0 || config.loss_rate>1) {
+	fprintf(stderr, "invalid <loss_rate>\n");
+	exit(-1);
+    }
+    config.corrupt_rate = atof(argv[6]);
+    if (config.corrupt_rate<0 || config.corrupt_rate>1) {
+	fprintf(stderr, "invalid <corrupt_rate>\n");
+	exit(-1);
+    }
+    config.seq_width = SeqWidthFor(config.window_size, seq_width_min);
+    if (!wait_buffer_set) config.wait_buffer = shared_wait_buffer(config.connections);
+    char coalesce_desc[64] = "sent alone";
+    if (config.coalesce)
+	snprintf(coalesce_desc, sizeof(coalesce_desc),
+		 "packed together, flushed within %.3fs", config.coalesce_delay);
+    char fec_desc[64] = "off";
+    if (config.fec_block>0)
+	snprintf(fec_desc, sizeof(fec_desc), "a parity packet per %d packets",
+		 config.fec_block);
+    char link_desc[256];
+    Link_Describe(&config.link, link_desc, sizeof(link_desc));
+    char trace_desc[256] = "off";
+    if (trace_path!=NULL)
+#ifdef RDT_NO_TRACE
+	snprintf(trace_desc, sizeof(trace_desc), "compiled out");
+#else
+	snprintf(trace_desc, sizeof(trace_desc), "the last %d events, to %s",
+		 trace_ring_size, trace_path);
+#endif
+    config.tracing_level = atoi(argv[7]);
+    if (config.tracing_level<0 || config.tracing_level>2) {
+	fprintf(stderr, "invalid <tracing_level>\n");
+	exit(-1);
+    }
+    
+    fprintf(stdout, "## Reliable data transfer simulation with:\n"
+	    "\tsimulation time is %.3f seconds\n"
+	    "\taverage message arrival interval is %.3f seconds\n"
+	    "\taverage message size is %d bytes\n"
+	    "\tworkload is %s\n"
+	    "\tconnections sharing the link are %d\n"
+	    "\taverage out-of-order delivery rate is %.2f%%\n"
+	    "\taverage loss rate is %.2f%%\n"
+	    "\taverage corrupt rate is %.2f%%\n"
+	    "\tlink is %s\n"
+	    "\ttracing level is %d\n"
+	    "\twindow is %d packets, sequence numbers are %d bits\n"
+	    "\tpackets are up to %d bytes\n"
+	    "\tintegrity check is %s (%s)\n"
+	    "\tacks are %s%s, sent every %d packets\n"
+	    "\tsmall messages are %s\n"
+	    "\tforward error correction is %s\n"
+	    "\tbinary event trace is %s\n"
+	    "\tcongestion control is %s\n"
+	    "\tevent queue is %s\n"
+	    "\tretransmission timeout is %s\n"
+	    "\trandom seed is %u\n"
+	    "Please review these inputs and press <enter> to proceed.\n",
+	    config.sim_time, config.msg_arrivalint, config.msg_size,
+	    config.workload, config.connections,
+	    config.outoforder_rate*100.0, config.loss_rate*100.0,
+	    config.corrupt_rate*100.0, link_desc, config.tracing_level, 
+	    config.window_size, 8*config.seq_width-1, config.mtu,
+	    CheckName(config.check_kind), config.check_kind==CHECK_CRC32C 
+	    ? Crc32cImplName() : ChksumImplName(),
+	    config.sack ? "selective" : "cumulative", 
+	    config.fast_retransmit ? ", with fast retransmit" : "", config.ack_every,
+	    coalesce_desc,
+	    fec_desc,
+	    trace_desc,
+	    config.cc_kind,
+	    config.queue_kind,
+	    config.adaptive_rto ? "adaptive" : "fixed", config.seed);
+    if (!no_prompt) fgetc(stdin);
+
+    Simulation *sim = new Simulation(&config);
+    if (rto_log_path!=NULL) {
+	sim->rto_log = fopen(rto_log_path, "w");
+	if (sim->rto_log==NULL) {
+	    perror(rto_log_path);
+	    exit(-1);
+	}
+	fprintf(sim->rto_log, "time,conn,srtt,rttvar,rto\n");
+    }
+    if (cwnd_log_path!=NULL) {
+	sim->cwnd_log = fopen(cwnd_log_path, "w");
+	if (sim->cwnd_log==NULL) {
+	    perror(cwnd_log_path);
+	    exit(-1);
+	}
+	fprintf(sim->cwnd_log, "time,conn,cwnd,ssthresh\n");
+    }
+    if (series_path!=NULL) {
+	sim->series_log = fopen(series_path, "w");
+	if (sim->series_log==NULL) {
+	    perror(series_path);
+	    exit(-1);
+	}
+	sim->series_interval = series_interval;
+	fprintf(sim->series_log, "time,goodput,retransmission_ratio,waiting,"
+		"messages,latency_mean,latency_max\n");
+    }
+    if (trace_path!=NULL)
+	sim->trace = new TraceRing(trace_ring_size);
+
+    /* test the random number generator */
+    double randtest_sum = 0.0;
+    for (int i=0; i<1000; i++)
+	randtest_sum += myrandom(sim);
+    double randtest_avg = randtest_sum/1000;
+    if (randtest_avg<0.25 || randtest_avg>0.75) {
+	fprintf(stderr, 
+		"It appears that something is wrong with the random number.\n"
+		"Please try to run this again.\n"  
+		"Please report to me if the problem PERSISTS.\n");
+	exit(-1);
+    }
+
+    sim->run();
 
     fprintf(stdout, "\n");
     fprintf(stdout, "## Simulation completed at time %.2fs with\n" 
 	    "\t%d characters sent\n" 
 	    "\t%d characters delivered\n"
-	    "\t%d packets passed between the sender and the receiver\n", 
-	    sim_core.time(), tot_chars_sent, tot_chars_delivered, tot_pkts_passed);
-
-    if (message_verfication_passed && (tot_chars_sent==tot_chars_delivered))
+	    "\t%d packets (%lld bytes) passed between the sender and the receiver\n"
+	    "\t%d packets retransmitted by the sender\n"
+	    "\t(%d on timeout, %d fast, %d duplicate acks)\n"
+	    "\t%d acks sent by the receiver (%d on the ack delay)\n", 
+	    sim->sim_core.time(), sim->tot_chars_sent, sim->tot_chars_delivered,
+	    sim->tot_pkts_passed, sim->tot_bytes_passed, sim->stats.pkts_retransmitted,
+	    sim->stats.pkts_timeout_retransmitted, sim->stats.pkts_fast_retransmitted,
+	    sim->stats.dup_acks, sim->stats.acks_sent, sim->stats.acks_delayed);
+
+    const struct rdt_stats *stats = &sim->stats;
+    struct rdt_flow_stats flows;
+    sim->mean_flow(&flows);
+    if (strcmp(config.cc_kind, "none")!=0) {
+	fprintf(stdout, "## Congestion control (%s):\n"
+		"\tcwnd mean %.2f, max %.2f, final %.2f packets, ssthresh %.2f\n"
+		"\t%d window reductions, goodput %.1f bytes/s\n",
+		config.cc_kind, sim->mean_cwnd(), stats->cwnd_max, flows.cwnd,
+		flows.ssthresh, stats->cwnd_reductions,
+		sim->sim_core.time()>0 
+		? sim->tot_chars_delivered/sim->sim_core.time() : 0);
+	if (config.connections>1) {
+	    double all = 0;
+	    for (int c = 0; c<config.connections; c++) all += sim->mean_cwnd(c);
+	    fprintf(stdout, "\t(windows per connection, the mean and final "
+		    "ones averaged over the %d; mean %.2f packets in all)\n",
+		    config.connections, all);
+	}
+    }
+    if (config.connections>1) {
+	double least = 0, most = 0;
+	for (int c = 0; c<config.connections; c++) {
+	    double x = sim->goodput(c);
+	    if (c==0 || x<least) least = x;
+	    if (c==0 || x>most) most = x;
+	}
+	double total = sim->sim_core.time()>0
+	    ? sim->tot_chars_delivered/sim->sim_core.time() : 0;
+	fprintf(stdout, "## Connections (%d):\n"
+		"\taggregate goodput %.1f bytes/s\n"
+		"\tper connection min %.1f, mean %.1f, max %.1f bytes/s\n"
+		"\tJain fairness index %.4f\n",
+		config.connections, total, least, total/config.connections,
+		most, sim->fairness());
+    }
+    if (flow_log_path!=NULL) {
+	FILE *f = fopen(flow_log_path, "w");
+	if (f==NULL) {
+	    perror(flow_log_path);
+	}
+	else {
+	    fprintf(f, "conn,chars_sent,chars_delivered,goodput\n");
+	    for (int c = 0; c<config.connections; c++)
+		fprintf(f, "%d,%d,%d,%.3f\n", c, sim->conns[c].chars_sent,
+			sim->conns[c].chars_delivered, sim->goodput(c));
+	    fclose(f);
+	}
+    }
+    if (sim->tot_msgs_blocked>0 || sim->tot_msgs_dropped>0)
+	fprintf(stdout, "## Wait buffer (%d packets, %s when full):\n"
+		"\t%d messages held, %d messages (%d characters) dropped\n"
+		"\tat most %d packets waiting\n",
+		config.wait_buffer, config.wait_drop ? "drop" : "block",
+		sim->tot_msgs_blocked, sim->tot_msgs_dropped, 
+		sim->tot_chars_dropped, stats->wait_high);
+    if (config.coalesce)
+	fprintf(stdout, "## Coalescing (flush delay %.3fs):\n"
+		"\t%d messages packed into %d packets, %d flushed on the delay\n",
+		config.coalesce_delay, stats->msgs_accepted, stats->pkts_built,
+		stats->coalesce_flushes);
+    if (config.fec_block>0)
+	fprintf(stdout, "## Forward error correction (blocks of %d):\n"
+		"\t%d parity packets sent, %d packets recovered,"
+		" %d retransmitted\n",
+		config.fec_block, stats->fec_parity_sent, stats->fec_recovered,
+		stats->pkts_retransmitted);
+    const Histogram &latency = sim->latency;
+    fprintf(stdout, "## Message latency:\n"
+	    "\t%llu messages, mean %.4fs, min %.4fs\n"
+	    "\tp50 %.4fs, p90 %.4fs, p99 %.4fs, p99.9 %.4fs, max %.4fs\n",
+	    (unsigned long long)latency.count(), latency.mean(), latency.min(),
+	    latency.percentile(0.5), latency.percentile(0.9),
+	    latency.percentile(0.99), latency.percentile(0.999), latency.max());
+    if (latency_log_path!=NULL) {
+	FILE *f = fopen(latency_log_path, "w");
+	if (f==NULL) {
+	    perror(latency_log_path);
+	}
+	else {
+	    latency.dump(f);
+	    fclose(f);
+	}
+    }
+    if (config.link.rate>0 || config.link.burst
+	|| config.link.delay_kind!=DELAY_CLASSIC) {
+	fprintf(stdout, "## Link (%s):\n", link_desc);
+	sim->forward.report(stdout, "forward");
+	sim->reverse.report(stdout, "reverse");
+    }
+    if (config.sack)
+	fprintf(stdout, "## Selective acks:\n"
+		"\t%d packets reported received out of order\n",
+		stats->pkts_sacked);
+    if (stats->rto_updates>0)
+	fprintf(stdout, "## Retransmission timeout (%s):\n"
+		"\t%d round trip times sampled, %d backoffs\n"
+		"\tRTO min %.3fs, mean %.3fs, max %.3fs over %d updates\n"
+		"\tfinal srtt %.3fs, rttvar %.3fs, RTO %.3fs\n",
+		config.adaptive_rto ? "adaptive" : "fixed",
+		stats->rtt_samples, stats->rto_backoffs, stats->rto_min,
+		stats->rto_sum/stats->rto_updates, stats->rto_max, 
+		stats->rto_updates, flows.srtt, flows.rttvar, flows.rto);
+    if (stats->rto_updates>0 && config.connections>1)
+	fprintf(stdout, "\t(final estimates averaged over the %d connections)\n",
+		config.connections);
+
+    if (sim->trace!=NULL) {
+	unsigned long long recorded = sim->trace->recorded();
+	unsigned long long kept = recorded<sim->trace->capacity()
+	    ? recorded : sim->trace->capacity();
+	fprintf(stdout, "## Event trace:\n"
+		"\t%llu events recorded, the last %llu written to %s\n",
+		recorded, kept, trace_path);
+    }
+    fprintf(stdout, "## Event pools:\n");
+    sim->upper_event_pool.report(stdout);
+    sim->sender_event_pool.report(stdout);
+    sim->timeout_event_pool.report(stdout);
+    sim->receiver_event_pool.report(stdout);
+    sim->receiver_timeout_pool.report(stdout);
+
+    if (sim->passed())
 	fprintf(stdout, "## Congratulations! This session is error-free, loss-free, and in order.\n");
     else
 	fprintf(stdout, "## Something is wrong! This session is NOT error-free, loss-free, and in order.\n");
 
+    if (sim->rto_log!=NULL) fclose(sim->rto_log);
+    if (sim->cwnd_log!=NULL) fclose(sim->cwnd_log);
+    if (sim->series_log!=NULL) fclose(sim->series_log);
+    if (sim->trace!=NULL) {
+	if (!sim->trace->dump(trace_path)) perror(trace_path);
+	delete sim->trace;
+    }
+    delete sim;
     return 0;
 }
+
+#endif  /* RDT_NO_MAIN */
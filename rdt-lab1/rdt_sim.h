@@ -0,0 +1,406 @@
+/*
+ * FILE: rdt_sim.h
+ * DESCRIPTION: The simulation context.  Everything a simulation run touches
+ *       (parameters, the event chain, statistics, the random number
+ *       generator and the state of the sender and the receiver) lives in a
+ *       Simulation object, which is handed to every sender and receiver
+ *       routine, so independent simulations can run side by side on
+ *       different threads.
+ *
+ *       A simulation carries one or more connections over the same link,
+ *       each with an upper layer and rdt layers of its own.  The connection
+ *       being served is selected into the context before an rdt routine is
+ *       called, so the rdt layers see only their own state.
+ */
+
+
+#ifndef _RDT_SIM_H_
+#define _RDT_SIM_H_
+
+#include <stdio.h>
+#include <deque>
+#include <vector>
+
+#include "rdt_struct.h"
+#include "rdt_event.h"
+#include "rdt_pool.h"
+#include "rdt_stats.h"
+#include "rdt_random.h"
+#include "rdt_trace.h"
+#include "rdt_link.h"
+#include "rdt_hist.h"
+#include "rdt_workload.h"
+
+
+/*[]------------------------------------------------------------------------[]
+  |  event definitions
+  []------------------------------------------------------------------------[]*/
+
+enum {EVENT_SENDER_FROMUPPERLAYER=0, EVENT_SENDER_FROMLOWERLAYER,
+      EVENT_SENDER_TIMEOUT, EVENT_RECEIVER_FROMLOWERLAYER,
+      EVENT_RECEIVER_TIMEOUT};
+
+/* an event of one connection, the index of which it carries */
+class ConnectionEvent : public Event
+{
+public:
+    int conn;
+public:
+    ConnectionEvent() { conn = 0; }
+};
+
+/* the event that the upper layer at the sender instructs rdt layer to send out
+   a message */
+class EventSenderFromUpperLayer : public ConnectionEvent
+{
+public:
+    EventSenderFromUpperLayer() { event_type = EVENT_SENDER_FROMUPPERLAYER; }
+};
+
+/* the event that the lower layer at the sender informs the rdt layer that a
+   packet is received from the link.  the packet bytes trail the event in its
+   pool */
+class EventSenderFromLowerLayer : public ConnectionEvent
+{
+public:
+    struct packet pkt;
+public:
+    EventSenderFromLowerLayer() { event_type = EVENT_SENDER_FROMLOWERLAYER; }
+};
+
+/* the event that the timer at the sender expires */
+class EventSenderTimeout : public ConnectionEvent
+{
+public:
+    EventSenderTimeout() { event_type = EVENT_SENDER_TIMEOUT; }
+};
+
+/* the event that the lower layer at the receiver informs the rdt layer that a
+   packet is received from the link, the packet bytes trailing it too */
+class EventReceiverFromLowerLayer : public ConnectionEvent
+{
+public:
+    struct packet pkt;
+public:
+    EventReceiverFromLowerLayer() { event_type = EVENT_RECEIVER_FROMLOWERLAYER; }
+};
+
+/* the event that the timer at the receiver expires */
+class EventReceiverTimeout : public ConnectionEvent
+{
+public:
+    EventReceiverTimeout() { event_type = EVENT_RECEIVER_TIMEOUT; }
+};
+
+
+/*[]------------------------------------------------------------------------[]
+  |  simulation context
+  []------------------------------------------------------------------------[]*/
+
+/* the parameters of a simulation run */
+struct sim_config {
+    /* total simulation time, the simulation will end at this time (in
+       seconds) */
+    double sim_time;
+
+    /* average intervals between consecutive messages passed from the upper
+       layer at the sender (in seconds) */
+    double msg_arrivalint;
+
+    /* average size of messages (in bytes) */
+    int msg_size;
+
+    /* the workload generating the messages (a spec of rdt_workload.h), and
+       the size heavy-tailed message sizes are cut at (in bytes, 0 for 64
+       times msg_size).  the simulation sets msg_max to the largest message
+       the workload generates */
+    const char *workload;
+    int msg_max;
+
+    /* connections sharing the link, each with a workload of its own, and
+       the width of the connection field of the packet header (in bytes, 0
+       for a single connection) */
+    int connections;
+    int conn_width;
+
+    /* the probability that a packet is not delivered with the normal
+       latency: a value of 0.1 means that one in ten packets are not
+       delivered with the normal latency */
+    double outoforder_rate;
+
+    /* packet loss probability: a value of 0.1 means that one in ten packets
+       are lost on average */
+    double loss_rate;
+
+    /* packet corruption probability: a value of 0.1 means that one in ten
+       packets (excluding those lost) are corrupted on average.  note that
+       any part of the packet can be corrupted */
+    double corrupt_rate;
+
+    /* the bottleneck, burst loss and delay models of the link (rdt_link.h),
+       loss_rate and outoforder_rate above being those of the plain link */
+    struct link_config link;
+
+    /* tracing levels (higher level always prints out more information):
+       a tracing level of 0 turns off all traces while a tracing,
+       a tracing level of 1 turns on regular traces,
+       a tracing level of 2 prints out the delivered message */
+    int tracing_level;
+
+    /* seed of the random number generator */
+    unsigned int seed;
+
+    /* event queue engine driving the event chain, and the slot granularity
+       of the timer wheel engine (in seconds) */
+    const char *queue_kind;
+    double wheel_tick;
+
+    /* window of the sender and the receiver (in packets), and the width of
+       the sequence field of the packet header (in bytes, 1, 2 or 4), wide
+       enough for the window */
+    int window_size;
+    int seq_width;
+
+    /* the largest packet of the link, headers included (in bytes, up to
+       RDT_PKTSIZE_MAX), and the width of the payload size field it takes
+       (in bytes, 1 or 2) */
+    int mtu;
+    int size_width;
+
+    /* the integrity code guarding each packet (CHECK_SUM16 or CHECK_CRC32C
+       of utils.h), and the width of its field in bytes */
+    int check_kind;
+    int check_width;
+
+    /* whether the receiver acks every packet with a bitmap of the packets
+       it holds out of order, or only in-order packets cumulatively */
+    bool sack;
+
+    /* whether the sender resends the oldest packet after DUPACK_THRESH
+       duplicate acks (the receiver then acks out-of-order packets too) */
+    bool fast_retransmit;
+
+    /* room for packets waiting for the window at the sender (in packets),
+       and whether the upper layer drops a message finding no room, or holds
+       it and stops generating messages until there is room */
+    int wait_buffer;
+    bool wait_drop;
+
+    /* the receiver acks every ack_every in-order packets, or ack_delay
+       seconds after the first one left unacked, whichever comes first.  a
+       packet out of order, or filling a gap, is acked right away */
+    int ack_every;
+    double ack_delay;
+
+    /* whether the sender packs small messages together into packets, each
+       packet filled for at most coalesce_delay seconds: it goes out sooner
+       once full, or once nothing is left in flight */
+    bool coalesce;
+    double coalesce_delay;
+
+    /* packets per forward error correction block (a power of two up to
+       FEC_BLOCK_MAX of rdt_fec.h), each followed by an XOR parity packet,
+       or 0 for none */
+    int fec_block;
+
+    /* congestion control algorithm of the sender */
+    const char *cc_kind;
+
+    /* whether the sender estimates its retransmission timeout from measured
+       round trip times, or always waits the fixed TIME_OUT */
+    bool adaptive_rto;
+};
+
+struct SenderState;             /* defined by the sender */
+struct ReceiverState;           /* defined by the receiver */
+
+/* a connection over the link */
+struct Connection {
+    int id;                     /* in the connection field of its packets */
+
+    /* the rdt layers, and their timer events */
+    struct SenderState *sender;
+    struct ReceiverState *receiver;
+    EventSenderTimeout *sender_timer;
+    EventReceiverTimeout *receiver_timer;
+
+    /* the upper layer at the sender */
+    Workload *workload;
+
+    /* the next character generated at the sender and expected at the
+       receiver */
+    char generate_cnt;
+    char verify_cnt;
+
+    /* each message on its way, oldest first: when it was generated and
+       its size, checked as the receiver passes it up */
+    struct msg_stamp {
+        double time;
+        int size;
+    };
+    std::deque<struct msg_stamp> msg_stamps;
+
+    int chars_sent;
+    int chars_delivered;
+
+    /* the retransmission timeout and congestion window of the sender */
+    struct rdt_flow_stats flow;
+
+    /* a message the sender had no room for, held along with the arrival
+       event until acks make room */
+    struct message *held_msg;
+    EventSenderFromUpperLayer *held_e;
+};
+
+class Simulation
+{
+public:
+    struct sim_config cfg;
+
+    /* average one-way packet delivery latency, set to be 100ms */
+    double pkt_latency;
+
+    /* the two directions of the link, to the receiver and back */
+    Link forward;
+    Link reverse;
+
+    /* simulation event chain core */
+    EventChain sim_core;
+
+    /* typed pools all simulation events are allocated from */
+    EventPool<EventSenderFromUpperLayer> upper_event_pool;
+    EventPool<EventSenderFromLowerLayer> sender_event_pool;
+    EventPool<EventSenderTimeout> timeout_event_pool;
+    EventPool<EventReceiverFromLowerLayer> receiver_event_pool;
+    EventPool<EventReceiverTimeout> receiver_timeout_pool;
+
+    /* general statistics */
+    int tot_chars_sent;
+    int tot_chars_delivered;
+    int tot_pkts_passed;
+    long long tot_bytes_passed;
+
+    /* messages the upper layer had to hold or drop for want of room at the
+       sender */
+    int tot_msgs_blocked;
+    int tot_msgs_dropped;
+    int tot_chars_dropped;
+
+    /* counters reported by the rdt layers */
+    struct rdt_stats stats;
+
+    /* the connections, and the one being served */
+    std::vector<Connection> conns;
+    Connection *conn;
+
+    /* the latencies of the messages passed up, from when they were
+       generated */
+    Histogram latency;
+
+    /* if set, every RTO a sender takes is logged here as a CSV row of
+       time,conn,srtt,rttvar,rto */
+    FILE *rto_log;
+
+    /* if set, every congestion window a sender takes is logged here as a
+       CSV row of time,conn,cwnd,ssthresh */
+    FILE *cwnd_log;
+
+    /* if set, the rdt layers record their events here, written out at the
+       end of the run */
+    TraceRing *trace;
+
+    /* if set, the run is logged here every series_interval seconds as CSV
+       rows of time,goodput,retransmission_ratio,waiting,messages,
+       latency_mean,latency_max, each over the interval ending at time */
+    FILE *series_log;
+    double series_interval;
+
+    /* error flag set by message verification at the receiver */
+    bool message_verfication_passed;
+
+    /* the random number generator, seeded from cfg.seed */
+    Random rng;
+
+    /* the rdt layers of the connection being served, set up by
+       Sender_Init() and Receiver_Init() */
+    struct SenderState *sender;
+    struct ReceiverState *receiver;
+
+private:
+    /* the end of the interval of the time series being filled, and the
+       counters at its start, or over it so far */
+    double series_end;
+    int series_chars;
+    int series_sent;
+    int series_resent;
+    int series_msgs;
+    double series_latency_sum;
+    double series_latency_max;
+
+public:
+    /* cfg->queue_kind must name a valid event queue */
+    Simulation(const struct sim_config *cfg);
+    ~Simulation();
+
+    /* serve connection c: the rdt routines called next work on its state */
+    void select(int c) {
+        conn = &conns[c];
+        sender = conn->sender;
+        receiver = conn->receiver;
+    }
+
+    /* run the simulation to completion */
+    void run();
+
+    /* the congestion window of connection c averaged over the run so far,
+       and the mean of these over the connections with a window */
+    double mean_cwnd(int c);
+    double mean_cwnd();
+
+    /* the last retransmission timeout and congestion window of the senders,
+       each averaged over the connections that took one */
+    void mean_flow(struct rdt_flow_stats *mean);
+
+    /* the goodput of connection c over the run so far (in bytes/s), and
+       Jain's fairness index of the goodputs of all of them, 1 when they
+       are all the same and 1/n when one takes everything */
+    double goodput(int c);
+    double fairness();
+
+    /* write the rows of the time series for the intervals ending by now,
+       and with final set the one cut short at the end of the run */
+    void log_series(bool final);
+
+    /* count the latency of a message passed up into the time series */
+    void series_record(double latency);
+
+    /* whether the session was error-free, loss-free and in order */
+    bool passed() const {
+        return message_verfication_passed && (tot_chars_sent==tot_chars_delivered);
+    }
+};
+
+/* fill in the defaults of every option, those of the command line; the
+   run itself (sim_time to corrupt_rate) is left zero */
+void SimConfig_Default(struct sim_config *cfg);
+
+/* traces of the rdt layers, printed at tracing level 1 and above, and
+   recorded into the trace ring if there is one.  both are compiled out by
+   -DRDT_NO_TRACE */
+#ifdef RDT_NO_TRACE
+#define RDT_TRACE(sim, ...) do {} while (0)
+#define RDT_RECORD(sim, event, seq, a, b) do {} while (0)
+#else
+#define RDT_TRACE(sim, ...) \
+    do { \
+        if ((sim)->cfg.tracing_level>=1) fprintf(stdout, __VA_ARGS__); \
+    } while (0)
+#define RDT_RECORD(sim, event, seq, a, b) \
+    do { \
+        if ((sim)->trace!=NULL) \
+            (sim)->trace->add((sim)->sim_core.time(), (sim)->conn->id, \
+                              event, seq, a, b); \
+    } while (0)
+#endif
+
+#endif  /* _RDT_SIM_H_ */
@@ -0,0 +1,81 @@
+/*
+ * FILE: rdt_stats.h
+ * DESCRIPTION: Counters the rdt layers report to the simulator, printed with
+ *       the final report and collected by the batch runner.
+ */
+
+
+#ifndef _RDT_STATS_H_
+#define _RDT_STATS_H_
+
+struct rdt_stats {
+    int pkts_sent;              /* data packets the sender sent, resends
+                                   included */
+    int pkts_retransmitted;     /* packets the sender sent more than once */
+    int pkts_timeout_retransmitted; /* ... as their timer expired */
+    int pkts_fast_retransmitted;/* ... ahead of their timer, on duplicate or
+                                   selective acks */
+    int dup_acks;               /* acks repeating the last cumulative ack */
+    int wait_high;              /* most packets waiting for the window */
+    int msgs_accepted;          /* messages the sender took */
+    int pkts_built;             /* data packets they went out in */
+    int coalesce_flushes;       /* packets sent when the flush delay ran out */
+    int acks_sent;              /* acks the receiver sent */
+    int acks_delayed;           /* ... when the ack delay ran out */
+
+    /* forward error correction */
+    int fec_parity_sent;        /* parity packets the sender sent */
+    int fec_recovered;          /* packets the receiver rebuilt from parity */
+
+    /* selective acknowledgement */
+    int pkts_sacked;            /* packets reported received out of order */
+
+    /* retransmission timeout estimation at the sender */
+    int rtt_samples;            /* round trip times measured */
+    int rto_backoffs;           /* timeouts that doubled the RTO */
+    int rto_updates;            /* RTO values taken, the first one included */
+    double rto_sum;             /* sum, least and greatest of these values */
+    double rto_min;
+    double rto_max;
+
+    /* congestion window of the sender */
+    int cwnd_updates;
+    int cwnd_reductions;        /* on loss or timeout */
+    double cwnd_max;
+};
+
+/* the retransmission timeout and congestion window of the sender of one
+   connection, as the last update left them; the counters above sum these
+   updates over all the connections */
+struct rdt_flow_stats {
+    int rto_updates;
+    double srtt;                /* the estimate at the end of the run */
+    double rttvar;
+    double rto;
+
+    int cwnd_updates;
+    double cwnd_area;           /* integral of the window over time */
+    double cwnd_time;           /* time of the last update */
+    double cwnd;                /* the window after the last update */
+    double ssthresh;
+};
+
+class Simulation;
+
+/* get the statistics of the running simulation */
+struct rdt_stats *GetStats(Simulation *sim);
+
+/* record a new retransmission timeout of the sender of the current
+   connection, backoff included, along with the smoothed round trip time and
+   its variation it was derived from */
+void RecordRTO(Simulation *sim, double srtt, double rttvar, double rto);
+
+/* record a new round trip time estimate of the sender of the current
+   connection, one that leaves the timeout as it was */
+void RecordRTT(Simulation *sim, double srtt, double rttvar);
+
+/* record a new congestion window of the sender of the current connection,
+   along with its slow start threshold */
+void RecordCwnd(Simulation *sim, double cwnd, double ssthresh);
+
+#endif  /* _RDT_STATS_H_ */
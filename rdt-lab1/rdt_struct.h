@@ -22,12 +22,15 @@ struct message {
     char *data;
 };
 
-/* a packet is a data unit passed between rdt layer and the lower layer, each 
-   packet has a fixed size */
+/* a packet is a data unit passed between rdt layer and the lower layer.  it
+   carries its real length, size bytes at data, no more than the MTU of the
+   simulation: RDT_PKTSIZE unless set otherwise, RDT_PKTSIZE_MAX at most */
 #define RDT_PKTSIZE 128
+#define RDT_PKTSIZE_MAX 9000
 
 struct packet {
-    char data[RDT_PKTSIZE];
+    int size;
+    char *data;
 };
 
 #endif  /* _RDT_STRUCT_H_ */
@@ -0,0 +1,102 @@
+/*
+ * FILE: rdt_timer.h
+ * DESCRIPTION: Per-packet retransmission timers of the sender, one per
+ *       window slot, multiplexed onto the single simulator timer.
+ *       Armed timers sit in a binary min-heap keyed by expiry, ties going
+ *       to the timer armed first.  Disarming (a slot getting acknowledged)
+ *       is O(1): the slot forgets the stamp of its heap entry, which is
+ *       dropped lazily once it reaches the top.  Arming and expiry are
+ *       O(log n).
+ */
+
+
+#ifndef _RDT_TIMER_H_
+#define _RDT_TIMER_H_
+
+#include <algorithm>
+#include <vector>
+
+
+class SlotTimers
+{
+public:
+    /* timers within this much of the current time count as expired, the
+       simulator timer may fire a hair early due to rounding */
+    static constexpr double EPSILON = 1e-9;
+
+public:
+    SlotTimers(int nslots = 0) { resize(nslots); }
+
+    void resize(int nslots) {
+        stamp.assign(nslots, 0);
+        expire.assign(nslots, 0);
+        heap.clear();
+        next_stamp = 1;
+    }
+
+    /* (re)start the timer of a slot */
+    void arm(int slot, double when) {
+        stamp[slot] = next_stamp++;
+        expire[slot] = when;
+        heap.push_back(Entry(when, slot, stamp[slot]));
+        std::push_heap(heap.begin(), heap.end());
+    }
+
+    /* stop the timer of a slot */
+    void disarm(int slot) { stamp[slot] = 0; }
+
+    bool armed(int slot) const { return stamp[slot]!=0; }
+    double expiry(int slot) const { return expire[slot]; }
+
+    /* the earliest expiry among armed timers, false if none is armed */
+    bool earliest(double *when) {
+        drop_stale();
+        if (heap.empty()) return false;
+        *when = heap.front().when;
+        return true;
+    }
+
+    /* disarm and return the slot of the earliest timer if it has expired by
+       now, -1 otherwise */
+    int pop_expired(double now) {
+        drop_stale();
+        if (heap.empty() || heap.front().when > now + EPSILON) return -1;
+
+        int slot = heap.front().slot;
+        std::pop_heap(heap.begin(), heap.end());
+        heap.pop_back();
+        stamp[slot] = 0;
+        return slot;
+    }
+
+private:
+    struct Entry {
+        double when;
+        int slot;
+        unsigned long long stamp;
+
+        Entry(double when, int slot, unsigned long long stamp) {
+            this->when = when; this->slot = slot; this->stamp = stamp;
+        }
+        /* inverted, so std::*_heap keeps the earliest entry on top */
+        bool operator<(const Entry &o) const {
+            return when>o.when || (when==o.when && stamp>o.stamp);
+        }
+    };
+
+    /* the stamp of the live heap entry of each slot, 0 if disarmed.  an
+       entry whose stamp is not its slot's any more is stale */
+    std::vector<unsigned long long> stamp;
+    std::vector<double> expire;
+    std::vector<Entry> heap;
+    unsigned long long next_stamp;
+
+    void drop_stale() {
+        while (!heap.empty() && heap.front().stamp!=stamp[heap.front().slot]) {
+            std::pop_heap(heap.begin(), heap.end());
+            heap.pop_back();
+        }
+    }
+};
+
+#endif  /* _RDT_TIMER_H_ */
@@ -0,0 +1,109 @@
+/*
+ * FILE: rdt_trace.cc
+ * DESCRIPTION: The trace ring, and writing and decoding trace files.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+
+#include "rdt_trace.h"
+
+
+static const char *const event_names[TRACE_NEVENTS] = {
+    "enqueue", "send", "resend", "fast_resend", "parity_send", "ack_recv",
+    "ack_corrupt", "timeout", "pkt_recv", "pkt_corrupt", "parity_recv",
+    "recover", "ack_send", "ack_delayed"
+};
+
+const char *TraceEventName(int event)
+{
+    return event>=0 && event<TRACE_NEVENTS ? event_names[event] : "unknown";
+}
+
+bool TraceEventSender(int event)
+{
+    return event<TRACE_PKT_RECV;
+}
+
+TraceRing::TraceRing(size_t size)
+{
+    size_t n = 1;
+    while (n<size) n *= 2;
+    ring.resize(n);
+    mask = n-1;
+    total = 0;
+}
+
+bool TraceRing::dump(const char *path) const
+{
+    FILE *f = fopen(path, "wb");
+    if (f==NULL) return false;
+
+    struct trace_file_header h;
+    memcpy(h.magic, TRACE_MAGIC, sizeof(h.magic));
+    h.version = TRACE_VERSION;
+    h.record_size = sizeof(struct trace_record);
+    h.total = total;
+    h.count = total<ring.size() ? total : ring.size();
+
+    /* the oldest record kept is the next to be overwritten */
+    uint64_t first = total-h.count;
+    size_t head = first & mask;
+    size_t tail = h.count<ring.size()-head ? h.count : ring.size()-head;
+    bool ok = fwrite(&h, sizeof(h), 1, f)==1
+        && fwrite(&ring[head], sizeof(ring[0]), tail, f)==tail
+        && fwrite(&ring[0], sizeof(ring[0]), h.count-tail, f)==h.count-tail;
+    return fclose(f)==0 && ok;
+}
+
+bool TraceDecode(FILE *in, FILE *out, bool csv)
+{
+    struct trace_file_header h;
+    if (fread(&h, sizeof(h), 1, in)!=1
+        || memcmp(h.magic, TRACE_MAGIC, sizeof(h.magic))!=0) {
+        fprintf(stderr, "not a trace file\n");
+        return false;
+    }
+    if (h.version!=TRACE_VERSION || h.record_size!=sizeof(struct trace_record)) {
+        fprintf(stderr, "trace file version %u with %u-byte records, "
+                "expected version %u with %u-byte records\n", h.version,
+                h.record_size, TRACE_VERSION,
+                (unsigned)sizeof(struct trace_record));
+        return false;
+    }
+
+    if (csv)
+        fprintf(out, "time,conn,side,event,seq,in_flight,waiting,expected,"
+                "unacked\n");
+    else
+        fprintf(out, "## %llu events recorded, the last %llu of them follow\n",
+                (unsigned long long)h.total, (unsigned long long)h.count);
+
+    struct trace_record r;
+    uint64_t n;
+    for (n = 0; n<h.count && fread(&r, sizeof(r), 1, in)==1; n++) {
+        bool sender = TraceEventSender(r.event);
+        const char *name = TraceEventName(r.event);
+        if (csv && sender)
+            fprintf(out, "%.6f,%u,sender,%s,%u,%d,%d,,\n", r.time, r.conn,
+                    name, r.seq, r.state[0], r.state[1]);
+        else if (csv)
+            fprintf(out, "%.6f,%u,receiver,%s,%u,,,%d,%d\n", r.time, r.conn,
+                    name, r.seq, r.state[0], r.state[1]);
+        else if (sender)
+            fprintf(out, "At %.6fs: conn %u sender %s(%u), in flight %d, "
+                    "waiting %d\n", r.time, r.conn, name, r.seq, r.state[0],
+                    r.state[1]);
+        else
+            fprintf(out, "At %.6fs: conn %u receiver %s(%u), expected %d, "
+                    "unacked %d\n", r.time, r.conn, name, r.seq, r.state[0],
+                    r.state[1]);
+    }
+    if (n<h.count) {
+        fprintf(stderr, "trace file cut short after %llu of %llu records\n",
+                (unsigned long long)n, (unsigned long long)h.count);
+        return false;
+    }
+    return true;
+}
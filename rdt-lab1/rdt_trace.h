@@ -0,0 +1,95 @@
+/*
+ * FILE: rdt_trace.h
+ * DESCRIPTION: Binary event traces of the rdt layers.  Where the text traces
+ *       format every event as it happens, a trace ring keeps a fixed-size
+ *       record of it (what happened, when, on which connection, the
+ *       sequence number and the window state of the layer) in memory,
+ *       overwriting the oldest once full.  The records are written out once
+ *       at the end of the run and decoded to text or CSV afterwards by
+ *       rdt_tracedump.
+ *
+ *       Recording costs a test of sim->trace when no ring is set, and
+ *       nothing at all built with -DRDT_NO_TRACE, which compiles the text
+ *       traces out too.
+ *
+ *       The file is a trace_file_header followed by its records, oldest
+ *       first, in the byte order of the host that wrote it.
+ */
+
+
+#ifndef _RDT_TRACE_H_
+#define _RDT_TRACE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+
+/* the events recorded.  the window state of a sender event is the packets
+   in flight and waiting for the window, of a receiver event the sequence
+   number expected next and the in-order packets not acked yet */
+enum {TRACE_ENQUEUE=0, TRACE_SEND, TRACE_RESEND, TRACE_FAST_RESEND,
+      TRACE_PARITY_SEND, TRACE_ACK_RECV, TRACE_ACK_CORRUPT, TRACE_TIMEOUT,
+      TRACE_PKT_RECV, TRACE_PKT_CORRUPT, TRACE_PARITY_RECV, TRACE_RECOVER,
+      TRACE_ACK_SEND, TRACE_ACK_DELAYED, TRACE_NEVENTS};
+
+struct trace_record {
+    double time;
+    uint32_t seq;
+    uint16_t event;
+    uint16_t conn;              /* the connection, 0 to CONN_MAX */
+    int32_t state[2];
+};
+
+#define TRACE_MAGIC "RDTTRACE"
+const uint32_t TRACE_VERSION = 2;
+
+struct trace_file_header {
+    char magic[8];              /* TRACE_MAGIC, not NUL-terminated */
+    uint32_t version;
+    uint32_t record_size;       /* sizeof(struct trace_record) */
+    uint64_t total;             /* records made over the run */
+    uint64_t count;             /* the newest of them, following */
+};
+
+/* the records of a run, the newest capacity() of them */
+class TraceRing
+{
+public:
+    /* room for at least size records, rounded up to a power of two */
+    TraceRing(size_t size);
+
+    void add(double time, int conn, int event, uint32_t seq, int32_t a,
+             int32_t b) {
+        struct trace_record *r = &ring[total & mask];
+        r->time = time;
+        r->seq = seq;
+        r->event = (uint16_t)event;
+        r->conn = (uint16_t)conn;
+        r->state[0] = a;
+        r->state[1] = b;
+        total++;
+    }
+
+    size_t capacity() const { return ring.size(); }
+    uint64_t recorded() const { return total; }
+
+    /* write the records kept to a file, return false on error */
+    bool dump(const char *path) const;
+
+private:
+    std::vector<struct trace_record> ring;
+    uint64_t mask;
+    uint64_t total;
+};
+
+/* decode a trace file to text or to CSV rows of
+   time,conn,side,event,seq,in_flight,waiting,expected,unacked.  return false,
+   with a message on stderr, if it is not a trace file */
+bool TraceDecode(FILE *in, FILE *out, bool csv);
+
+/* the name of an event, and whether the sender records it */
+const char *TraceEventName(int event);
+bool TraceEventSender(int event);
+
+#endif  /* _RDT_TRACE_H_ */
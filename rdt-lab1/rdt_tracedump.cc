@@ -0,0 +1,36 @@
+/*
+ * FILE: rdt_tracedump.cc
+ * DESCRIPTION: Decode a binary trace written by rdt_sim --trace-file to
+ *       text, or with --csv to CSV rows.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+
+#include "rdt_trace.h"
+
+
+int main(int argc, char *argv[])
+{
+    bool csv = false;
+    const char *path = NULL;
+    for (int i = 1; i<argc; i++) {
+        if (strcmp(argv[i], "--csv")==0) csv = true;
+        else if (path==NULL) path = argv[i];
+        else path = "";
+    }
+    if (path==NULL || *path=='\0') {
+        fprintf(stderr, "usage: %s [--csv] <trace file>\n", argv[0]);
+        return 1;
+    }
+
+    FILE *in = fopen(path, "rb");
+    if (in==NULL) {
+        perror(path);
+        return 1;
+    }
+    bool ok = TraceDecode(in, stdout, csv);
+    fclose(in);
+    return ok ? 0 : 1;
+}
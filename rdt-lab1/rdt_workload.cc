@@ -0,0 +1,294 @@
+/*
+ * FILE: rdt_workload.cc
+ * DESCRIPTION: Workloads of the upper layer at the sender.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "rdt_workload.h"
+
+
+/* a size drawn from a continuous distribution, rounded into [1, max] */
+static int clamp_size(double size, int max)
+{
+    if (size<1) return 1;
+    if (size>max) return max;
+    return (int)(size+0.5);
+}
+
+
+/*[]------------------------------------------------------------------------[]
+  |  uniform
+  []------------------------------------------------------------------------[]*/
+
+class UniformWorkload : public Workload
+{
+public:
+    UniformWorkload(double mean_gap, int mean_size) {
+        this->mean_gap = mean_gap;
+        this->mean_size = mean_size;
+    }
+
+    int size(Random *rng) {
+        int size = (int)(rng->uniform()*2.0*mean_size);
+        return size>0 ? size : 1;
+    }
+    double gap(Random *rng) { return mean_gap*2.0*rng->uniform(); }
+    int max_size() const { return 2*mean_size; }
+
+protected:
+    double mean_gap;
+    int mean_size;
+};
+
+
+/*[]------------------------------------------------------------------------[]
+  |  heavy-tailed sizes
+  []------------------------------------------------------------------------[]*/
+
+class ParetoWorkload : public UniformWorkload
+{
+public:
+    ParetoWorkload(double mean_gap, int mean_size, int max, double alpha)
+        : UniformWorkload(mean_gap, mean_size) {
+        this->max = max;
+        this->alpha = alpha;
+        scale = mean_size*(alpha-1)/alpha;
+    }
+
+    int size(Random *rng) {
+        return clamp_size(scale/pow(1-rng->uniform(), 1/alpha), max);
+    }
+    int max_size() const { return max; }
+
+private:
+    int max;
+    double alpha;
+    double scale;               /* the least size */
+};
+
+class LognormalWorkload : public UniformWorkload
+{
+public:
+    LognormalWorkload(double mean_gap, int mean_size, int max, double sigma)
+        : UniformWorkload(mean_gap, mean_size) {
+        this->max = max;
+        this->sigma = sigma;
+        mu = log((double)mean_size) - sigma*sigma/2;
+    }
+
+    int size(Random *rng) {
+        return clamp_size(exp(mu + sigma*rng->normal()), max);
+    }
+    int max_size() const { return max; }
+
+private:
+    int max;
+    double sigma;
+    double mu;
+};
+
+
+/*[]------------------------------------------------------------------------[]
+  |  on/off bursts
+  []------------------------------------------------------------------------[]*/
+
+class OnOffWorkload : public UniformWorkload
+{
+public:
+    OnOffWorkload(double mean_gap, int mean_size, double on, double off)
+        : UniformWorkload(mean_gap*on/(on+off), mean_size) {
+        this->on = on;
+        this->off = off;
+        on_left = -1;
+    }
+
+    /* the gap within a burst, stretched by the off periods it runs into */
+    double gap(Random *rng) {
+        if (on_left<0) on_left = rng->exponential(on);
+        double busy = UniformWorkload::gap(rng);
+        double total = busy;
+        while (busy>on_left) {
+            busy -= on_left;
+            total += rng->exponential(off);
+            on_left = rng->exponential(on);
+        }
+        on_left -= busy;
+        return total;
+    }
+
+private:
+    double on;
+    double off;
+    double on_left;             /* of the current on period, -1 before it */
+};
+
+
+/*[]------------------------------------------------------------------------[]
+  |  trace replay
+  []------------------------------------------------------------------------[]*/
+
+class TraceWorkload : public Workload
+{
+public:
+    TraceWorkload() { map = NULL; len = 0; }
+    ~TraceWorkload() { if (map!=NULL) munmap(map, len); }
+
+    /* map the file and check it through, false with a message if it cannot
+       be replayed */
+    bool open(const char *path);
+
+    double start() const { return first_time; }
+    int size(Random *rng) { return cur_size; }
+    int max_size() const { return max; }
+
+    double gap(Random *rng) {
+        double time = cur_time;
+        if (!next(&cur_time, &cur_size)) return -1;
+        return cur_time-time;
+    }
+
+private:
+    char *map;
+    size_t len;
+    const char *cursor;         /* the first line not read yet */
+    int lineno;
+    double first_time;
+    double cur_time;            /* of the message arriving now */
+    int cur_size;
+    int max;
+
+    enum { LINE_MAX_LEN = 256 };
+
+    /* read the next record, false at the end of the file or, with
+       *error set, at a line that is not a record */
+    bool next(double *time, int *size, bool *error = NULL);
+};
+
+bool TraceWorkload::next(double *time, int *size, bool *error)
+{
+    const char *end = map+len;
+    if (error!=NULL) *error = false;
+    while (cursor<end) {
+        const char *eol = (const char*)memchr(cursor, '\n', end-cursor);
+        if (eol==NULL) eol = end;
+        size_t n = eol-cursor;
+        char line[LINE_MAX_LEN];
+        if (n>=sizeof(line)) n = sizeof(line)-1;
+        memcpy(line, cursor, n);
+        line[n] = '\0';
+        cursor = eol<end ? eol+1 : end;
+        lineno++;
+
+        const char *p = line;
+        while (*p==' ' || *p=='\t' || *p=='\r') p++;
+        if (*p=='\0' || *p=='#') continue;
+        char sep[2];
+        if (sscanf(p, "%lf%1[ ,\t]%d", time, sep, size)==3 && *size>0
+            && *time>=0)
+            return true;
+        /* a header line may open the file */
+        if (lineno==1 && (p[0]<'0' || p[0]>'9') && p[0]!='.') continue;
+        if (error!=NULL) *error = true;
+        return false;
+    }
+    return false;
+}
+
+bool TraceWorkload::open(const char *path)
+{
+    int fd = ::open(path, O_RDONLY);
+    if (fd<0) {
+        perror(path);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st)!=0 || st.st_size==0) {
+        fprintf(stderr, "%s: empty trace\n", path);
+        close(fd);
+        return false;
+    }
+    len = st.st_size;
+    map = (char*)mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map==MAP_FAILED) {
+        map = NULL;
+        perror(path);
+        return false;
+    }
+    madvise(map, len, MADV_SEQUENTIAL);
+
+    /* one pass to check the records and find the largest, the replay
+       reads them again from the start */
+    cursor = map;
+    lineno = 0;
+    int count = 0;
+    double time, last = 0;
+    int size;
+    bool error;
+    max = 0;
+    while (next(&time, &size, &error)) {
+        if (count>0 && time<last) {
+            fprintf(stderr, "%s:%d: timestamp goes back\n", path, lineno);
+            return false;
+        }
+        last = time;
+        if (size>max) max = size;
+        count++;
+    }
+    if (error || count==0) {
+        fprintf(stderr, "%s:%d: not a timestamp,size record\n", path, lineno);
+        return false;
+    }
+
+    cursor = map;
+    lineno = 0;
+    next(&cur_time, &cur_size);
+    first_time = cur_time;
+    return true;
+}
+
+
+/*[]------------------------------------------------------------------------[]
+  |  the workload of a spec
+  []------------------------------------------------------------------------[]*/
+
+Workload *Workload_Create(const char *spec, double mean_gap, int mean_size,
+                          int max_size)
+{
+    const char *args = strchr(spec, ':');
+    size_t n = args!=NULL ? (size_t)(args-spec) : strlen(spec);
+    if (args!=NULL) args++;
+
+    if (strncmp(spec, "uniform", n)==0 && n==7 && args==NULL)
+        return new UniformWorkload(mean_gap, mean_size);
+    if (strncmp(spec, "pareto", n)==0 && n==6) {
+        double alpha = args!=NULL ? atof(args) : 1.5;
+        if (alpha>1) return new ParetoWorkload(mean_gap, mean_size, max_size, alpha);
+    }
+    if (strncmp(spec, "lognormal", n)==0 && n==9) {
+        double sigma = args!=NULL ? atof(args) : 1.0;
+        if (sigma>0) return new LognormalWorkload(mean_gap, mean_size, max_size, sigma);
+    }
+    if (strncmp(spec, "onoff", n)==0 && n==5) {
+        double on = 1.0, off = 1.0;
+        if (args==NULL || (sscanf(args, "%lf,%lf", &on, &off)==2 && on>0 && off>0))
+            return new OnOffWorkload(mean_gap, mean_size, on, off);
+    }
+    if (strncmp(spec, "trace", n)==0 && n==5 && args!=NULL) {
+        TraceWorkload *w = new TraceWorkload;
+        if (w->open(args)) return w;
+        delete w;
+        return NULL;
+    }
+    fprintf(stderr, "invalid workload %s\n", spec);
+    return NULL;
+}
@@ -0,0 +1,60 @@
+/*
+ * FILE: rdt_workload.h
+ * DESCRIPTION: Workloads of the upper layer at the sender: when messages
+ *       arrive and how large they are.
+ *
+ *       uniform            - sizes uniform in [1, 2*mean_size), gaps uniform
+ *                            in [0, 2*mean_gap) (the original generator)
+ *       pareto[:alpha]     - Pareto sizes of shape alpha (default 1.5) and
+ *                            the mean size, uniform gaps
+ *       lognormal[:sigma]  - lognormal sizes of the mean size and log
+ *                            standard deviation sigma (default 1), uniform
+ *                            gaps
+ *       onoff[:on,off]     - uniform sizes in bursts: on periods (default
+ *                            1s) of messages arriving (on+off)/on times as
+ *                            often as mean_gap, then off periods (default
+ *                            1s) of none, both exponentially distributed
+ *       trace:<file>       - replay a file of "timestamp,size" lines (in
+ *                            seconds and bytes, timestamps not decreasing,
+ *                            '#' comments), read through a memory map as
+ *                            the run goes; the arrival interval and size
+ *                            given are ignored
+ *
+ *       The heavy-tailed sizes are cut at max_size, so a message always
+ *       fits the wait buffer of the sender.
+ */
+
+
+#ifndef _RDT_WORKLOAD_H_
+#define _RDT_WORKLOAD_H_
+
+#include "rdt_random.h"
+
+
+class Workload
+{
+public:
+    virtual ~Workload() {}
+
+    /* when the first message arrives (in seconds) */
+    virtual double start() const { return 0; }
+
+    /* the size of the message arriving now (in bytes, at least 1) */
+    virtual int size(Random *rng) = 0;
+
+    /* the time from the message arriving now to the next (in seconds), or
+       a negative value if there are no more */
+    virtual double gap(Random *rng) = 0;
+
+    /* the largest message it generates (in bytes) */
+    virtual int max_size() const = 0;
+};
+
+/* create a workload from its spec, of messages mean_size bytes large every
+   mean_gap seconds on average, heavy-tailed sizes cut at max_size.  return
+   NULL, with a message on stderr, if the spec is invalid or the trace file
+   cannot be read */
+Workload *Workload_Create(const char *spec, double mean_gap, int mean_size,
+                          int max_size);
+
+#endif  /* _RDT_WORKLOAD_H_ */
@@ -1,13 +1,156 @@
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 #include "utils.h"
 
-void incNum(seq_nr_t& num, int max){ 
-    num = (num + 1) % max;
+int HeaderSize(int seq_width, int check_width, int size_width, int conn_width){
+    return check_width + size_width + seq_width + conn_width;
 }
 
-u_int16_t chksum(void *data, u_int8_t len){
+int ConnWidth(int nconns){
+    return nconns > 1 ? 2 : 0;
+}
+
+int SizeWidth(int mtu){
+    return mtu <= 256 ? 1 : 2;
+}
+
+void PutSize(struct packet *pkt, int check_width, int size_width, int size){
+    u_int8_t *field = (u_int8_t*)pkt->data + check_width;
+    if(size_width == 2) *field++ = (u_int8_t)(size >> 8);
+    *field = (u_int8_t)size;
+}
+
+int GetSize(const struct packet *pkt, int check_width, int size_width){
+    const u_int8_t *field = (const u_int8_t*)pkt->data + check_width;
+    return size_width == 2 ? (field[0] << 8) | field[1] : field[0];
+}
+
+void PutChunkHeader(char *field, int len, bool end_flag){
+    field[0] = (char)((len >> 8) | (end_flag ? 0x80 : 0));
+    field[1] = (char)len;
+}
+
+int GetChunkHeader(const char *field, bool *end_flag){
+    const u_int8_t *f = (const u_int8_t*)field;
+    *end_flag = (f[0] & 0x80) != 0;
+    return ((f[0] & 0x7f) << 8) | f[1];
+}
+
+int CheckKind(const char *name){
+    if(strcmp(name, "sum16") == 0) return CHECK_SUM16;
+    if(strcmp(name, "crc32c") == 0) return CHECK_CRC32C;
+    return -1;
+}
+
+const char *CheckName(int kind){
+    return kind == CHECK_CRC32C ? "crc32c" : "sum16";
+}
+
+int CheckWidth(int kind){
+    return kind == CHECK_CRC32C ? 4 : 2;
+}
+
+/* the check field is stored in host byte order, as the checksum always
+   was */
+void PutCheck(struct packet *pkt, int kind, int len){
+    int width = CheckWidth(kind);
+    if(kind == CHECK_CRC32C){
+        u_int32_t crc = crc32c(pkt->data + width, len - width);
+        memcpy(pkt->data, &crc, sizeof(crc));
+    }else{
+        u_int16_t sum = chksum(pkt->data + width, len - width);
+        memcpy(pkt->data, &sum, sizeof(sum));
+    }
+}
+
+bool CheckPassed(const struct packet *pkt, int kind, int len){
+    int width = CheckWidth(kind);
+    if(kind == CHECK_CRC32C){
+        u_int32_t crc;
+        memcpy(&crc, pkt->data, sizeof(crc));
+        return crc == crc32c(pkt->data + width, len - width);
+    }
+    u_int16_t sum;
+    memcpy(&sum, pkt->data, sizeof(sum));
+    return sum == chksum(pkt->data + width, len - width);
+}
+
+uint64_t SeqSize(int seq_width){
+    return (uint64_t)1 << (8 * seq_width - 1);
+}
+
+int SeqWidthFor(int window, int min_width){
+    int width = min_width;
+    while(width < 4 && SeqSize(width) < 2 * (uint64_t)window) width *= 2;
+    return width;
+}
+
+void PutSeq(struct packet *pkt, int check_width, int size_width, int seq_width, seq_nr_t seq, bool end_flag){
+    u_int8_t *field = (u_int8_t*)pkt->data + check_width + size_width;
+    for(int i = seq_width - 1; i >= 0; i--){
+        field[i] = (u_int8_t)seq;
+        seq >>= 8;
+    }
+    if(end_flag) field[0] |= 0x80;
+}
+
+seq_nr_t GetSeq(const struct packet *pkt, int check_width, int size_width, int seq_width){
+    const u_int8_t *field = (const u_int8_t*)pkt->data + check_width + size_width;
+    seq_nr_t seq = field[0] & 0x7f;
+    for(int i = 1; i < seq_width; i++)
+        seq = (seq << 8) | field[i];
+    return seq;
+}
+
+bool GetEndFlag(const struct packet *pkt, int check_width, int size_width){
+    return (((const u_int8_t*)pkt->data)[check_width + size_width] & 0x80) != 0;
+}
+
+void PutConn(struct packet *pkt, int check_width, int size_width, int seq_width, int conn_width, int conn){
+    if(conn_width == 0) return;
+    u_int8_t *field = (u_int8_t*)pkt->data + check_width + size_width + seq_width;
+    field[0] = (u_int8_t)(conn >> 8);
+    field[1] = (u_int8_t)conn;
+}
+
+int GetConn(const struct packet *pkt, int check_width, int size_width, int seq_width, int conn_width){
+    if(conn_width == 0) return 0;
+    const u_int8_t *field = (const u_int8_t*)pkt->data + check_width + size_width + seq_width;
+    return (field[0] << 8) | field[1];
+}
+
+void incNum(seq_nr_t& num, uint64_t max){ 
+    num = (seq_nr_t)((num + (uint64_t)1) % max);
+}
+
+seq_nr_t addNum(seq_nr_t num, uint64_t delta, uint64_t max){
+    return (seq_nr_t)((num + delta % max) % max);
+}
+
+uint64_t distance(seq_nr_t from, seq_nr_t to, uint64_t max){
+    return (to + max - from) % max;
+}
+
+/* the checksum is the ones' complement of the ones' complement sum of the
+   data as big-endian 16-bit words, an odd last byte padded with a zero.
+   every implementation below adds the words up exactly, as the sum of the
+   bytes at even offsets times 256 plus the sum of the bytes at odd
+   offsets, and folds the total the same way, so they agree bit for bit */
+static u_int16_t chksum_fold(u_int32_t acc){
+    acc = (acc >> 16) + (acc & 0x0000ffffUL);
+    if ((acc & 0xffff0000UL) != 0) {
+        acc = (acc >> 16) + (acc & 0x0000ffffUL);
+    }
+    return ~(u_int16_t)acc;
+}
+
+/* one byte at a time, the reference */
+static u_int16_t chksum_bytes(const void *data, int len){
   u_int32_t acc = 0;
   u_int16_t src;
-  u_int8_t *octetptr = (u_int8_t*)data;
+  const u_int8_t *octetptr = (const u_int8_t*)data;
   while (len > 1) {
     src = (*octetptr) << 8;
     octetptr++;
@@ -20,16 +163,215 @@ u_int16_t chksum(void *data, u_int8_t len){
     src = (*octetptr) << 8;
     acc += src;
   }
-  acc = (acc >> 16) + (acc & 0x0000ffffUL);
-  if ((acc & 0xffff0000UL) != 0) {
-    acc = (acc >> 16) + (acc & 0x0000ffffUL);
-  }
-  src = (u_int16_t)acc;
-  return ~src;
+  return chksum_fold(acc);
+}
+
+/* the exact sum of the big-endian words of p[0..len), 8 bytes at a time:
+   the even and odd bytes of a word are masked into four 16-bit lanes each,
+   summed lane-wise.  the lanes are added up every 64 words, before their
+   total can overflow 16 bits.  the wide loops below finish with it */
+static u_int32_t chksum_sum64(const u_int8_t *p, int len){
+    const uint64_t mask = 0x00ff00ff00ff00ffULL;
+    u_int32_t acc = 0;
+    while(len >= 8){
+        uint64_t even = 0, odd = 0;
+        for(int n = 0; n < 64 && len >= 8; n++, p += 8, len -= 8){
+            uint64_t w;
+            memcpy(&w, p, 8);
+            even += w & mask;           /* little endian: even offsets low */
+            odd += (w >> 8) & mask;
+        }
+        /* the sum of the four lanes ends up in the top one */
+        even = (even * 0x0001000100010001ULL) >> 48;
+        odd = (odd * 0x0001000100010001ULL) >> 48;
+        acc += (u_int32_t)(even << 8) + (u_int32_t)odd;
+    }
+    for(; len >= 2; p += 2, len -= 2)
+        acc += (p[0] << 8) | p[1];
+    if(len > 0) acc += p[0] << 8;
+    return acc;
+}
+
+static u_int16_t chksum_word64(const void *data, int len){
+    return chksum_fold(chksum_sum64((const u_int8_t*)data, len));
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/* 16 bytes at a time: the even and odd bytes are masked apart and summed
+   into 64-bit lanes by psadbw, which cannot overflow */
+__attribute__((target("sse2")))
+static u_int16_t chksum_sse2(const void *data, int len){
+    const u_int8_t *p = (const u_int8_t*)data;
+    const __m128i mask = _mm_set1_epi16(0x00ff);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i even = zero, odd = zero;
+    for(; len >= 16; p += 16, len -= 16){
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        even = _mm_add_epi64(even, _mm_sad_epu8(_mm_and_si128(v, mask), zero));
+        odd = _mm_add_epi64(odd, _mm_sad_epu8(_mm_srli_epi16(v, 8), zero));
+    }
+    uint64_t e = (uint64_t)_mm_cvtsi128_si64(even) + (uint64_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(even, even));
+    uint64_t o = (uint64_t)_mm_cvtsi128_si64(odd) + (uint64_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(odd, odd));
+    return chksum_fold((u_int32_t)((e << 8) + o) + chksum_sum64(p, len));
+}
+
+/* the same 32 bytes at a time */
+__attribute__((target("avx2")))
+static u_int16_t chksum_avx2(const void *data, int len){
+    const u_int8_t *p = (const u_int8_t*)data;
+    const __m256i mask = _mm256_set1_epi16(0x00ff);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i even = zero, odd = zero;
+    for(; len >= 32; p += 32, len -= 32){
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        even = _mm256_add_epi64(even, _mm256_sad_epu8(_mm256_and_si256(v, mask), zero));
+        odd = _mm256_add_epi64(odd, _mm256_sad_epu8(_mm256_srli_epi16(v, 8), zero));
+    }
+    /* a last half block in the low lanes */
+    if(len >= 16){
+        __m256i v = _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)p));
+        v = _mm256_permute2x128_si256(v, v, 0x80);  /* zero the upper half */
+        even = _mm256_add_epi64(even, _mm256_sad_epu8(_mm256_and_si256(v, mask), zero));
+        odd = _mm256_add_epi64(odd, _mm256_sad_epu8(_mm256_srli_epi16(v, 8), zero));
+        p += 16;
+        len -= 16;
+    }
+    uint64_t e[4], o[4];
+    _mm256_storeu_si256((__m256i*)e, even);
+    _mm256_storeu_si256((__m256i*)o, odd);
+    uint64_t sum = ((e[0] + e[1] + e[2] + e[3]) << 8) + o[0] + o[1] + o[2] + o[3];
+    return chksum_fold((u_int32_t)sum + chksum_sum64(p, len));
+}
+#endif
+
+static const struct {
+    const char *name;
+    chksum_fn fn;
+} chksum_impls[] = {
+    {"bytes", chksum_bytes},
+    {"word64", chksum_word64},
+#if defined(__x86_64__) || defined(__i386__)
+    {"sse2", chksum_sse2},
+    {"avx2", chksum_avx2},
+#endif
+};
+
+static bool chksum_supported(const char *name){
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();       /* may run ahead of main() */
+    if(strcmp(name, "sse2") == 0) return __builtin_cpu_supports("sse2");
+    if(strcmp(name, "avx2") == 0) return __builtin_cpu_supports("avx2");
+#endif
+    return true;
+}
+
+chksum_fn ChksumImpl(const char *name){
+    for(size_t i = 0; i < sizeof(chksum_impls) / sizeof(chksum_impls[0]); i++){
+        if(strcmp(chksum_impls[i].name, name) == 0)
+            return chksum_supported(name) ? chksum_impls[i].fn : NULL;
+    }
+    return NULL;
+}
+
+/* the widest implementation the cpu runs, picked once at startup, before
+   any simulation thread is started */
+static const char *chksum_pick(){
+    static const char *const widest[] = {"avx2", "sse2", "word64"};
+    for(size_t i = 0; i < sizeof(widest) / sizeof(widest[0]); i++){
+        if(ChksumImpl(widest[i]) != NULL) return widest[i];
+    }
+    return "bytes";
 }
 
-bool between(seq_nr_t left, seq_nr_t target, seq_nr_t right){
-    return ((left <= target && target < right) 
-            || (right < left && left <= target) 
-            || (target < right && right < left));
-}
\ No newline at end of file
+static const char *chksum_name = chksum_pick();
+static chksum_fn chksum_best = ChksumImpl(chksum_name);
+
+const char *ChksumImplName(){
+    return chksum_name;
+}
+
+u_int16_t chksum(const void *data, int len){
+    return chksum_best(data, len);
+}
+
+/* CRC32C, reflected, polynomial 0x1edc6f41.  slicing-by-8 looks up each of
+   8 bytes in a table of its own and xors the results: table k holds the
+   CRC of a byte followed by k zero bytes */
+static const u_int32_t CRC32C_POLY = 0x82f63b78;    /* reflected */
+static u_int32_t crc32c_table[8][256];
+
+__attribute__((constructor))
+static void crc32c_init(){
+    for(int b = 0; b < 256; b++){
+        u_int32_t crc = b;
+        for(int k = 0; k < 8; k++)
+            crc = (crc >> 1) ^ (CRC32C_POLY & (0 - (crc & 1)));
+        crc32c_table[0][b] = crc;
+    }
+    for(int b = 0; b < 256; b++){
+        for(int k = 1; k < 8; k++){
+            u_int32_t crc = crc32c_table[k - 1][b];
+            crc32c_table[k][b] = (crc >> 8) ^ crc32c_table[0][crc & 0xff];
+        }
+    }
+}
+
+static u_int32_t crc32c_slice8(const void *data, int len){
+    const u_int8_t *p = (const u_int8_t*)data;
+    u_int32_t crc = 0xffffffff;
+    for(; len >= 8; p += 8, len -= 8){
+        u_int32_t lo, hi;
+        memcpy(&lo, p, 4);              /* little endian */
+        memcpy(&hi, p + 4, 4);
+        lo ^= crc;
+        crc = crc32c_table[7][lo & 0xff] ^ crc32c_table[6][(lo >> 8) & 0xff]
+            ^ crc32c_table[5][(lo >> 16) & 0xff] ^ crc32c_table[4][lo >> 24]
+            ^ crc32c_table[3][hi & 0xff] ^ crc32c_table[2][(hi >> 8) & 0xff]
+            ^ crc32c_table[1][(hi >> 16) & 0xff] ^ crc32c_table[0][hi >> 24];
+    }
+    for(; len > 0; p++, len--)
+        crc = (crc >> 8) ^ crc32c_table[0][(crc ^ *p) & 0xff];
+    return ~crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static u_int32_t crc32c_sse42(const void *data, int len){
+    const u_int8_t *p = (const u_int8_t*)data;
+    uint64_t crc = 0xffffffff;
+    for(; len >= 8; p += 8, len -= 8){
+        uint64_t w;
+        memcpy(&w, p, 8);
+        crc = _mm_crc32_u64(crc, w);
+    }
+    u_int32_t crc32 = (u_int32_t)crc;
+    for(; len > 0; p++, len--)
+        crc32 = _mm_crc32_u8(crc32, *p);
+    return ~crc32;
+}
+#endif
+
+crc32c_fn Crc32cImpl(const char *name){
+    if(strcmp(name, "slice8") == 0) return crc32c_slice8;
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if(strcmp(name, "sse42") == 0)
+        return __builtin_cpu_supports("sse4.2") ? crc32c_sse42 : NULL;
+#endif
+    return NULL;
+}
+
+static const char *crc32c_name = Crc32cImpl("sse42") != NULL ? "sse42" : "slice8";
+static crc32c_fn crc32c_best = Crc32cImpl(crc32c_name);
+
+const char *Crc32cImplName(){
+    return crc32c_name;
+}
+
+u_int32_t crc32c(const void *data, int len){
+    return crc32c_best(data, len);
+}
+
+bool between(seq_nr_t left, seq_nr_t target, seq_nr_t right, uint64_t max){
+    return distance(left, target, max) < distance(left, right, max);
+}
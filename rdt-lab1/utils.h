@@ -3,16 +3,125 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include "rdt_struct.h"
+
+const int WINDOW_SIZE = 10;     // default window, in packets
+const int WINDOW_MAX = 1 << 20;
+
+const int MTU_MIN = 32;         // smallest packet the link may be set to carry
+
+// default room for packets waiting for the window, in packets
+const int WAIT_BUFFER_SIZE = 4096;
 
-const int WINDOW_SIZE = 10;
-const int SEQ_SIZE = 128; // 2^8 
 const double TIME_OUT = 0.3;
 
+// bounds of the adaptive retransmission timeout, and the least margin it
+// keeps over the smoothed round trip time
+const double RTO_MIN = 0.1;
+const double RTO_MAX = 10.0;
+const double RTO_GRANULARITY = 0.01;
+
+// duplicate acks, or packets selectively acked above an unacknowledged one,
+// before it is taken as lost and resent ahead of its timer
+const int DUPACK_THRESH = 3;
+
 typedef unsigned int seq_nr_t;
 
-void incNum(seq_nr_t& num, int max);
+// packet header shared by the sender and the receiver:
+//
+// |<- 2 or 4 bytes ->|<- 1 or 2 bytes ->|<- 1, 2 or 4 bytes ->|<- 0 or 2 ->|<- the rest ->|
+// |  integrity check |   payload size   |   sequence field    | connection |   payload    |
+//
+// the payload size field is one byte wide up to an MTU of 256 bytes, two
+// (big-endian) above.  the top bit of the (big-endian) sequence field flags
+// the last packet of a message, the other 7, 15 or 31 bits hold the
+// sequence number.  the (big-endian) connection field is there only when
+// several connections share the link, and tells them apart.  the integrity
+// check covers everything after itself up to the end of the payload, which
+// is where the packet ends.
+//
+// with coalescing, the payload of a data packet is a run of chunks, each a
+// CHUNK_HEADER byte (big-endian) header followed by a piece of a message:
+// the top bit of the header flags the piece ending its message, the other
+// 15 bits give its length.  the end flag of the packet is left clear.
+//
+// an ack carries the last sequence number received in order.  a selective
+// ack also carries a bitmap as its payload: bit i (msb first) is set if the
+// packet ack+2+i has been received out of order.
+int HeaderSize(int seq_width, int check_width, int size_width, int conn_width);
+
+// width of the connection field for nconns connections
+int ConnWidth(int nconns);
+const int CONN_MAX = 65535;
+
+// width of the payload size field of packets of up to mtu bytes
+int SizeWidth(int mtu);
+
+void PutSize(struct packet *pkt, int check_width, int size_width, int size);
+int GetSize(const struct packet *pkt, int check_width, int size_width);
+
+const int CHUNK_HEADER = 2;
+
+void PutChunkHeader(char *field, int len, bool end_flag);
+int GetChunkHeader(const char *field, bool *end_flag);
+
+// integrity codes of the check field: the 16-bit ones' complement checksum
+// below, or a CRC32C
+enum { CHECK_SUM16 = 0, CHECK_CRC32C };
+
+// the code of a name ("sum16" or "crc32c"), -1 if unknown, and back
+int CheckKind(const char *name);
+const char *CheckName(int kind);
+
+// width of the check field, in bytes
+int CheckWidth(int kind);
+
+// fill in, or verify, the check field of a packet whose header and payload
+// take len bytes
+void PutCheck(struct packet *pkt, int kind, int len);
+bool CheckPassed(const struct packet *pkt, int kind, int len);
+
+// number of distinct sequence numbers of a sequence field
+uint64_t SeqSize(int seq_width);
+
+// the narrowest sequence field of at least min_width bytes whose sequence
+// numbers can tell a window's worth of packets from the next one's
+int SeqWidthFor(int window, int min_width);
+
+void PutSeq(struct packet *pkt, int check_width, int size_width, int seq_width, seq_nr_t seq, bool end_flag);
+seq_nr_t GetSeq(const struct packet *pkt, int check_width, int size_width, int seq_width);
+bool GetEndFlag(const struct packet *pkt, int check_width, int size_width);
+
+// connection 0 without a connection field
+void PutConn(struct packet *pkt, int check_width, int size_width, int seq_width, int conn_width, int conn);
+int GetConn(const struct packet *pkt, int check_width, int size_width, int seq_width, int conn_width);
+
+// arithmetic on numbers wrapping around at max
+void incNum(seq_nr_t& num, uint64_t max);
+seq_nr_t addNum(seq_nr_t num, uint64_t delta, uint64_t max);
+uint64_t distance(seq_nr_t from, seq_nr_t to, uint64_t max);
+
+u_int16_t chksum(const void *data, int len);
+
+// the implementations of chksum(), by name: "bytes" (the reference),
+// "word64", "sse2" and "avx2".  they return the same checksums; NULL if
+// the name is unknown or the cpu cannot run it.  chksum() runs the widest
+// one the cpu supports
+typedef u_int16_t (*chksum_fn)(const void *data, int len);
+chksum_fn ChksumImpl(const char *name);
+const char *ChksumImplName();
+
+// CRC32C (Castagnoli) of len bytes
+u_int32_t crc32c(const void *data, int len);
 
-u_int16_t chksum(void *data, u_int8_t len);
+// the implementations of crc32c(), by name: "slice8" (table driven, 8 bytes
+// per step) and "sse42" (the crc32 instruction).  NULL if the name is
+// unknown or the cpu cannot run it.  crc32c() runs sse42 where it can
+typedef u_int32_t (*crc32c_fn)(const void *data, int len);
+crc32c_fn Crc32cImpl(const char *name);
+const char *Crc32cImplName();
 
-bool between(seq_nr_t left, seq_nr_t target, seq_nr_t right);
+// whether target lies in [left, right) on a circle of max numbers
+bool between(seq_nr_t left, seq_nr_t target, seq_nr_t right, uint64_t max);
 #endif